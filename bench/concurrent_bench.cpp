@@ -0,0 +1,230 @@
+//
+// a multi-threaded stress test for sjtu::concurrent_map and sjtu::sharded_map,
+// and their throughput next to a std::map behind one mutex
+// every thread writes its own keys only, so whatever the interleaving the
+// final contents are those of replaying the threads one after another on a
+// single-threaded sjtu::map; reads may hit any key and check that the value
+// they get belongs to it
+// usage: concurrent_bench [threads] [ops per thread], exits 1 on a mismatch
+//
+#include "map.hpp"
+#include "concurrent_map.hpp"
+#include "sharded_map.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+const int kKeys = 1 << 16;
+
+class Timer {
+ private:
+  std::chrono::steady_clock::time_point start;
+ public:
+  Timer() : start(std::chrono::steady_clock::now()) {}
+  double NsPerOp(long long ops) const {
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+    return spent.count() / ops;
+  }
+};
+
+void Report(const char *name, const char *phase, double ns) {
+  printf("%-14s %-16s %10.1f ns/op\n", name, phase, ns);
+}
+
+// a value tells the key it was written for
+int ValueOf(int key, int op) {
+  return key * 64 + (op & 63);
+}
+
+bool BelongsTo(int value, int key) {
+  return value / 64 == key;
+}
+
+struct Op {
+  enum Kind { kRead, kWrite, kErase } kind;
+  int key;
+};
+
+/**
+ * the ops of thread id out of threads; write_percent of them write or erase
+ * keys owned by it (key % threads == id), the rest read any key
+ */
+std::vector<Op> OpsOf(int id, int threads, int ops, int write_percent) {
+  std::mt19937 rng(20230326 + id);
+  std::vector<Op> result(ops);
+  for (int i = 0; i < ops; ++i) {
+    int roll = rng() % 100, key = rng() % kKeys;
+    if (roll >= write_percent) {
+      result[i] = Op{Op::kRead, key};
+    } else {
+      key = key - key % threads + id;
+      if (key >= kKeys) key -= threads;
+      result[i] = Op{roll % 4 ? Op::kWrite : Op::kErase, key};
+    }
+  }
+  return result;
+}
+
+// the same ops on one std::map, every call under the mutex
+class LockedMap {
+ private:
+  std::mutex lock;
+  std::map<int, int> m;
+ public:
+  bool find(int key, int &obj) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = m.find(key);
+    if (it == m.end()) return false;
+    obj = it->second;
+    return true;
+  }
+  void insert_or_assign(int key, int obj) {
+    std::lock_guard<std::mutex> guard(lock);
+    m[key] = obj;
+  }
+  void erase(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    m.erase(key);
+  }
+  template<class Visit>
+  void for_each(Visit visit) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &value : m) visit(value);
+  }
+};
+
+// runs every thread's ops on m at once, returns how many reads went wrong
+template<class Map>
+long long RunThreads(Map &m, const std::vector<std::vector<Op>> &ops, double &ns) {
+  std::atomic<bool> go(false);
+  std::atomic<long long> wrong(0);
+  std::vector<std::thread> threads;
+  for (const std::vector<Op> &mine : ops) {
+    threads.emplace_back([&m, &mine, &go, &wrong] {
+      while (!go.load()) std::this_thread::yield();
+      long long bad = 0;
+      for (int i = 0; i < (int) mine.size(); ++i) {
+        int obj;
+        switch (mine[i].kind) {
+          case Op::kRead:
+            if (m.find(mine[i].key, obj) && !BelongsTo(obj, mine[i].key)) ++bad;
+            break;
+          case Op::kWrite:
+            m.insert_or_assign(mine[i].key, ValueOf(mine[i].key, i));
+            break;
+          case Op::kErase:
+            m.erase(mine[i].key);
+            break;
+        }
+      }
+      wrong += bad;
+    });
+  }
+  Timer timer;
+  go = true;
+  for (std::thread &thread : threads) thread.join();
+  ns = timer.NsPerOp((long long) ops.size() * ops[0].size());
+  return wrong;
+}
+
+// what the ops leave behind, one thread after another
+sjtu::map<int, int> Replay(const std::vector<std::vector<Op>> &ops) {
+  sjtu::map<int, int> m;
+  for (const std::vector<Op> &mine : ops) {
+    for (int i = 0; i < (int) mine.size(); ++i) {
+      if (mine[i].kind == Op::kWrite) {
+        m[mine[i].key] = ValueOf(mine[i].key, i);
+      } else if (mine[i].kind == Op::kErase) {
+        m.erase(mine[i].key);
+      }
+    }
+  }
+  return m;
+}
+
+// whether m holds exactly what expected does, in the same order
+template<class Map>
+bool SameAs(Map &m, const sjtu::map<int, int> &expected) {
+  auto it = expected.cbegin();
+  bool same = true;
+  m.for_each([&](const auto &value) {
+    if (it == expected.cend() || it->first != value.first || it->second != value.second) {
+      same = false;
+      return;
+    }
+    ++it;
+  });
+  return same && it == expected.cend();
+}
+
+// 16 equal ranges of the keys
+sjtu::range_partition<int, 16> RangeSplits() {
+  std::vector<int> splits;
+  for (int i = 1; i < 16; ++i) splits.push_back(kKeys / 16 * i);
+  return sjtu::range_partition<int, 16>(splits);
+}
+
+bool Run(int threads, int ops, int write_percent) {
+  std::vector<std::vector<Op>> all;
+  for (int i = 0; i < threads; ++i) all.push_back(OpsOf(i, threads, ops, write_percent));
+  sjtu::map<int, int> expected = Replay(all);
+  char phase[32];
+  snprintf(phase, sizeof(phase), "%d%% writes", write_percent);
+  bool ok = true;
+  double ns;
+
+  sjtu::concurrent_map<int, int> concurrent;
+  long long wrong = RunThreads(concurrent, all, ns);
+  Report("concurrent", phase, ns);
+  if (wrong || !SameAs(concurrent, expected) || concurrent.size() != expected.size()) {
+    printf("concurrent_map: %lld bad reads, contents %s\n", wrong,
+           SameAs(concurrent, expected) ? "match" : "differ");
+    ok = false;
+  }
+
+  sjtu::sharded_map<int, int> sharded;
+  wrong = RunThreads(sharded, all, ns);
+  Report("sharded", phase, ns);
+  if (wrong || !SameAs(sharded, expected) || sharded.size() != expected.size()) {
+    printf("sharded_map: %lld bad reads, contents %s\n", wrong, SameAs(sharded, expected) ? "match" : "differ");
+    ok = false;
+  }
+
+  sjtu::sharded_map<int, int, std::less<int>, 16, sjtu::range_partition<int, 16>> ranged(RangeSplits());
+  wrong = RunThreads(ranged, all, ns);
+  Report("sharded range", phase, ns);
+  if (wrong || !SameAs(ranged, expected) || ranged.size() != expected.size()) {
+    printf("sharded_map by range: %lld bad reads, contents %s\n", wrong, SameAs(ranged, expected) ? "match" : "differ");
+    ok = false;
+  }
+
+  LockedMap locked;
+  wrong = RunThreads(locked, all, ns);
+  Report("std+mutex", phase, ns);
+  if (wrong || !SameAs(locked, expected)) {
+    printf("std::map: %lld bad reads, contents %s\n", wrong, SameAs(locked, expected) ? "match" : "differ");
+    ok = false;
+  }
+  return ok;
+}
+}
+
+int main(int argc, char *argv[]) {
+  int threads = argc > 1 ? atoi(argv[1]) : (int) std::max(2u, std::thread::hardware_concurrency());
+  int ops = argc > 2 ? atoi(argv[2]) : 1000000;
+  printf("%d threads, %d ops each\n", threads, ops);
+  bool ok = true;
+  for (int write_percent : {0, 10, 50}) {
+    ok = Run(threads, ops, write_percent) && ok;
+  }
+  puts(ok ? "ok" : "MISMATCH");
+  return ok ? 0 : 1;
+}
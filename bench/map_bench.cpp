@@ -0,0 +1,149 @@
+//
+// micro-benchmarks for sjtu::map and its persistent and copy-on-write front ends
+// build with optimization (the map_bench target does) and run without arguments
+//
+#include "map.hpp"
+#include "persistent_map.hpp"
+#include "cow_map.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+namespace {
+const int kKeys = 1000000;
+
+class Timer {
+ private:
+  std::chrono::steady_clock::time_point start;
+ public:
+  Timer() : start(std::chrono::steady_clock::now()) {}
+  double NsPerOp(int ops) const {
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+    return spent.count() / ops;
+  }
+};
+
+void Report(const char *name, const char *phase, double ns) {
+  printf("%-8s %-18s %10.1f ns/op\n", name, phase, ns);
+}
+
+std::vector<int> IntKeys(bool shuffled) {
+  std::vector<int> keys(kKeys);
+  for (int i = 0; i < kKeys; ++i) keys[i] = i;
+  if (shuffled) std::shuffle(keys.begin(), keys.end(), std::mt19937(20230326));
+  return keys;
+}
+
+std::vector<std::string> StringKeys(bool shuffled) {
+  std::vector<std::string> keys(kKeys);
+  // zero padded so that the string order is the numeric order
+  char buffer[32];
+  for (int i = 0; i < kKeys; ++i) {
+    snprintf(buffer, sizeof(buffer), "key-%012d", i);
+    keys[i] = buffer;
+  }
+  if (shuffled) std::shuffle(keys.begin(), keys.end(), std::mt19937(20230326));
+  return keys;
+}
+
+template<class Key>
+void RunTreeOps(const char *name, const std::vector<Key> &keys, const std::vector<Key> &sorted) {
+  long long checksum = 0;
+  {
+    sjtu::map<Key, int> m;
+    Timer timer;
+    for (int i = 0; i < kKeys; ++i) m[keys[i]] = i;
+    Report(name, "insert random", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    for (int i = 0; i < kKeys; ++i) checksum += m.find(keys[i])->second;
+    Report(name, "find hit", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    for (auto it = m.begin(); it != m.end(); ++it) checksum += it->second;
+    Report(name, "iterate", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    sjtu::map<Key, int> copy(m);
+    Report(name, "copy", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    copy = m;
+    Report(name, "copy assign", timer.NsPerOp(kKeys));
+    checksum += copy.size();
+
+    timer = Timer();
+    for (int i = 0; i < kKeys; ++i) m.erase(m.find(keys[i]));
+    Report(name, "erase random", timer.NsPerOp(kKeys));
+  }
+  {
+    sjtu::map<Key, int, std::less<Key>, std::allocator<sjtu::pair<const Key, int>>, sjtu::threaded_policy> m;
+    for (int i = 0; i < kKeys; ++i) m[keys[i]] = i;
+    Timer timer;
+    for (auto it = m.begin(); it != m.end(); ++it) checksum += it->second;
+    Report(name, "iterate threaded", timer.NsPerOp(kKeys));
+  }
+  {
+    sjtu::cow_map<Key, int> m;
+    for (int i = 0; i < kKeys; ++i) m[keys[i]] = i;
+    Timer timer;
+    sjtu::cow_map<Key, int> copy(m);
+    Report(name, "cow copy", timer.NsPerOp(kKeys));
+
+    // the first write pays for the clone
+    timer = Timer();
+    copy[keys[0]] = -1;
+    Report(name, "cow first write", timer.NsPerOp(kKeys));
+    checksum += copy.size();
+  }
+  {
+    sjtu::persistent_map<Key, int> m;
+    Timer timer;
+    for (int i = 0; i < kKeys; ++i) m = m.insert_or_assign(keys[i], i);
+    Report(name, "persistent insert", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    for (int i = 0; i < kKeys; ++i) {
+      sjtu::persistent_map<Key, int> snapshot(m);
+      checksum += snapshot.size();
+    }
+    Report(name, "snapshot", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    for (int i = 0; i < kKeys; ++i) m = m.erase(keys[i]);
+    Report(name, "persistent erase", timer.NsPerOp(kKeys));
+  }
+  {
+    sjtu::map<Key, int> m;
+    Timer timer;
+    for (int i = 0; i < kKeys; ++i) m[sorted[i]] = i;
+    Report(name, "insert sorted", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    m.clear();
+    Report(name, "clear", timer.NsPerOp(kKeys));
+
+    timer = Timer();
+    for (int i = 0; i < kKeys; ++i) m.insert(m.end(), typename sjtu::map<Key, int>::value_type(sorted[i], i));
+    Report(name, "insert hinted", timer.NsPerOp(kKeys));
+
+    std::vector<sjtu::pair<Key, int>> snapshot;
+    snapshot.reserve(kKeys);
+    for (int i = 0; i < kKeys; ++i) snapshot.emplace_back(sorted[i], i);
+    timer = Timer();
+    sjtu::map<Key, int> rebuilt(snapshot.begin(), snapshot.end());
+    Report(name, "build sorted", timer.NsPerOp(kKeys));
+    checksum += rebuilt.size();
+  }
+  printf("%-8s checksum %lld\n", name, checksum);
+}
+}
+
+int main() {
+  RunTreeOps("int", IntKeys(true), IntKeys(false));
+  RunTreeOps("string", StringKeys(true), StringKeys(false));
+  return 0;
+}
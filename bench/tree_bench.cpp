@@ -0,0 +1,90 @@
+//
+// the same workload on the ordered maps of this repo, side by side:
+// sjtu::map with AVL and red-black balancing, and sjtu::btree_map
+//
+#include "map.hpp"
+#include "btree_map.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+namespace {
+const int kKeys = 1000000;
+
+class Timer {
+ private:
+  std::chrono::steady_clock::time_point start;
+ public:
+  Timer() : start(std::chrono::steady_clock::now()) {}
+  double NsPerOp(int ops) const {
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+    return spent.count() / ops;
+  }
+};
+
+void Report(const char *engine, const char *name, const char *phase, double ns) {
+  printf("%-6s %-8s %-16s %10.1f ns/op\n", engine, name, phase, ns);
+}
+
+std::vector<int> IntKeys() {
+  std::vector<int> keys(kKeys);
+  for (int i = 0; i < kKeys; ++i) keys[i] = i;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(20230326));
+  return keys;
+}
+
+std::vector<std::string> StringKeys() {
+  std::vector<std::string> keys(kKeys);
+  char buffer[32];
+  for (int i = 0; i < kKeys; ++i) {
+    snprintf(buffer, sizeof(buffer), "key-%012d", i);
+    keys[i] = buffer;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(20230326));
+  return keys;
+}
+
+template<class Map, class Key>
+void Run(const char *engine, const char *name, const std::vector<Key> &keys) {
+  long long checksum = 0;
+  Map m;
+  Timer timer;
+  for (int i = 0; i < kKeys; ++i) m[keys[i]] = i;
+  Report(engine, name, "insert random", timer.NsPerOp(kKeys));
+
+  timer = Timer();
+  for (int i = 0; i < kKeys; ++i) checksum += m.find(keys[i])->second;
+  Report(engine, name, "find hit", timer.NsPerOp(kKeys));
+
+  timer = Timer();
+  for (auto it = m.begin(); it != m.end(); ++it) checksum += it->second;
+  Report(engine, name, "iterate", timer.NsPerOp(kKeys));
+
+  timer = Timer();
+  for (int i = 0; i < kKeys; ++i) m.erase(m.find(keys[i]));
+  Report(engine, name, "erase random", timer.NsPerOp(kKeys));
+  printf("%-6s %-8s checksum %lld\n", engine, name, checksum);
+}
+
+template<class Key>
+using avl_map = sjtu::map<Key, int>;
+
+template<class Key>
+using rb_map = sjtu::map<Key, int, std::less<Key>, std::allocator<sjtu::pair<const Key, int>>, sjtu::red_black_policy>;
+
+template<class Key>
+void RunAll(const char *name, const std::vector<Key> &keys) {
+  Run<avl_map<Key>>("avl", name, keys);
+  Run<rb_map<Key>>("rb", name, keys);
+  Run<sjtu::btree_map<Key, int>>("btree", name, keys);
+}
+}
+
+int main() {
+  RunAll("int", IntKeys());
+  RunAll("string", StringKeys());
+  return 0;
+}
@@ -0,0 +1,198 @@
+// sjtu::btree_map checked against std::map: int keys (searched with SIMD),
+// string keys and descending comparators, with enough keys for leaves and
+// inner nodes to split, borrow and merge, and the same exceptions as sjtu::map
+#include <iostream>
+#include <map>
+#include <string>
+#include <functional>
+#include <cstdio>
+#include "btree_map.hpp"
+#include "map.hpp"
+
+using namespace std;
+
+unsigned Last = 20230328;
+
+int Rand() {
+  Last = Last * 1103515245u + 12345u;
+  return int(Last >> 8);
+}
+
+// descending or ascending, chosen when the map is made, so the map has to keep it
+struct Direction {
+  bool down;
+  explicit Direction(bool _down = false) : down(_down) {}
+  bool operator()(int one, int another) const {
+    return down ? another < one : one < another;
+  }
+};
+
+int KeyOf(int key, int) {
+  return key;
+}
+
+std::string KeyOf(int key, std::string) {
+  // shared prefixes, keys of different lengths
+  return std::string(key % 5, 'b') + std::to_string(key);
+}
+
+// same elements in the same order, walked both ways
+template<class Map, class StdMap>
+bool Same(Map &Q, const StdMap &stdQ) {
+  if (Q.size() != (int) stdQ.size() || Q.empty() != stdQ.empty()) return false;
+  typename Map::iterator it = Q.begin();
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it) {
+    if (it == Q.end() || !(it->first == stdit->first) || it->second != stdit->second) return false;
+  }
+  if (it != Q.end()) return false;
+  typename Map::const_iterator cit = Q.cend();
+  for (auto stdit = stdQ.rbegin(); stdit != stdQ.rend(); ++stdit) {
+    --it, --cit;
+    if (!(it->first == stdit->first) || !(cit->first == stdit->first)) return false;
+  }
+  return it == Q.begin() && cit == Q.cbegin();
+}
+
+/**
+ * grows to n keys in random order, then shrinks by random erases (by key
+ * and by iterator) down to a few, checking all the way: leaves and inner
+ * nodes split on the way up, borrow and merge on the way down
+ */
+template<class Key, class Compare>
+bool Random(int n, const Compare &comp = Compare()) {
+  sjtu::btree_map<Key, int, Compare> Q(comp);
+  std::map<Key, int, Compare> stdQ(comp);
+  int range = n * 2;
+  while ((int) stdQ.size() < n) {
+    Key key = KeyOf(Rand() % range, Key());
+    int value = Rand(), kind = Rand() % 4;
+    if (kind == 0) {
+      Q[key] = value, stdQ[key] = value;
+    } else if (kind == 1) {
+      if (Q.insert(sjtu::pair<const Key, int>(key, value)).second != stdQ.insert(std::make_pair(key, value)).second) return false;
+    } else if (kind == 2) {
+      if (Q.emplace(key, value).second != stdQ.emplace(key, value).second) return false;
+    } else {
+      if (Q.try_emplace(key, value).second != stdQ.emplace(key, value).second) return false;
+    }
+    if ((int) stdQ.size() % 997 == 0 && !Same(Q, stdQ)) return false;
+  }
+  if (!Same(Q, stdQ)) return false;
+  // lookups of keys that are there and keys that aren't
+  const sjtu::btree_map<Key, int, Compare> &constQ = Q;
+  for (int i = 0; i < n; ++i) {
+    Key key = KeyOf(Rand() % (range + 10), Key());
+    auto stdit = stdQ.find(key), stdlo = stdQ.lower_bound(key), stdup = stdQ.upper_bound(key);
+    typename sjtu::btree_map<Key, int, Compare>::iterator it = Q.find(key), lo = Q.lower_bound(key), up = Q.upper_bound(key);
+    typename sjtu::btree_map<Key, int, Compare>::const_iterator cit = constQ.find(key);
+    if ((it == Q.end()) != (stdit == stdQ.end()) || (cit == constQ.cend()) != (stdit == stdQ.end())) return false;
+    if (stdit != stdQ.end() && (it->second != stdit->second || cit->second != stdit->second || constQ.at(key) != stdit->second)) return false;
+    if (Q.count(key) != (int) stdQ.count(key)) return false;
+    if ((lo == Q.end()) != (stdlo == stdQ.end()) || (stdlo != stdQ.end() && !(lo->first == stdlo->first))) return false;
+    if ((up == Q.end()) != (stdup == stdQ.end()) || (stdup != stdQ.end() && !(up->first == stdup->first))) return false;
+  }
+  // erase down to a few, erase(pos) hands back the element after pos
+  while ((int) stdQ.size() > 5) {
+    Key key = KeyOf(Rand() % range, Key());
+    if (Rand() % 2) {
+      if (Q.erase(key) != (int) stdQ.erase(key)) return false;
+    } else {
+      auto stdit = stdQ.lower_bound(key);
+      if (stdit == stdQ.end()) continue;
+      typename sjtu::btree_map<Key, int, Compare>::iterator next = Q.erase(Q.find(stdit->first));
+      stdit = stdQ.erase(stdit);
+      if ((next == Q.end()) != (stdit == stdQ.end()) || (stdit != stdQ.end() && !(next->first == stdit->first))) return false;
+    }
+    if ((int) stdQ.size() % 997 == 0 && !Same(Q, stdQ)) return false;
+  }
+  if (!Same(Q, stdQ)) return false;
+  // a copy keeps the comparator and the elements, and is a map of its own
+  sjtu::btree_map<Key, int, Compare> R(Q);
+  for (int i = 0; i < 100; ++i) {
+    Key key = KeyOf(Rand() % range, Key());
+    R[key] = i;
+  }
+  if (!Same(Q, stdQ)) return false;
+  Q = R;
+  std::map<Key, int, Compare> stdR(stdQ);
+  for (auto it = R.begin(); it != R.end(); ++it) stdR[it->first] = it->second;
+  if (!Same(Q, stdR)) return false;
+  // and everything goes by iterators too
+  for (typename sjtu::btree_map<Key, int, Compare>::iterator it = Q.begin(); it != Q.end();) it = Q.erase(it);
+  return Q.empty() && Q.begin() == Q.end() && Same(R, stdR);
+}
+
+bool check1() { // int keys, up to leaf splits only and up to three levels
+  return Random<int, std::less<int>>(50) && Random<int, std::less<int>>(300) && Random<int, std::less<int>>(30000);
+}
+
+bool check2() { // string keys
+  return Random<std::string, std::less<std::string>>(300) && Random<std::string, std::less<std::string>>(20000);
+}
+
+bool check3() { // descending: a stateless comparator, and one that keeps its direction
+  return Random<int, std::greater<int>>(20000) && Random<int, Direction>(20000, Direction(true)) &&
+         Random<int, Direction>(3000, Direction(false));
+}
+
+bool check4() { // begin, end and --end on empty and full maps
+  sjtu::btree_map<int, int> Q;
+  if (Q.begin() != Q.end() || Q.cbegin() != Q.cend()) return false;
+  for (int i = 0; i < 10000; ++i) Q[i * 3] = i;
+  if (Q.begin()->first != 0 || (--Q.end())->first != 9999 * 3 || (--Q.cend())->second != 9999) return false;
+  sjtu::btree_map<int, int>::iterator it = Q.end();
+  for (int i = 9999; i >= 0; --i) {
+    --it;
+    if (it->first != i * 3) return false;
+  }
+  if (it != Q.begin()) return false;
+  Q.clear();
+  return Q.begin() == Q.end() && Q.empty();
+}
+
+// whether both maps throw the same exception (or none) for the same misuse
+template<class Map, class Do>
+int Thrown(Map &Q, Do action) {
+  try {
+    action(Q);
+  } catch (sjtu::invalid_iterator &) {
+    return 1;
+  } catch (sjtu::index_out_of_bound &) {
+    return 2;
+  } catch (...) {
+    return 3;
+  }
+  return 0;
+}
+
+template<class Do>
+bool Alike(Do action) {
+  sjtu::btree_map<int, int> Q, otherQ;
+  sjtu::map<int, int> R, otherR;
+  for (int i = 0; i < 500; ++i) Q[i] = i, R[i] = i, otherQ[i] = i, otherR[i] = i;
+  int one = Thrown(Q, [&](sjtu::btree_map<int, int> &m) { action(m, otherQ); });
+  int another = Thrown(R, [&](sjtu::map<int, int> &m) { action(m, otherR); });
+  return one == another && one != 0 && Q.size() == 500 && R.size() == 500;
+}
+
+bool check5() { // end() and iterators of other maps throw what sjtu::map throws
+  return Alike([](auto &m, auto &) { m.erase(m.end()); }) &&
+         Alike([](auto &m, auto &other) { m.erase(other.begin()); }) &&
+         Alike([](auto &m, auto &other) { m.erase(other.find(7)); }) &&
+         Alike([](auto &m, auto &) { *m.end(); }) &&
+         Alike([](auto &m, auto &) { ++m.end(); }) &&
+         Alike([](auto &m, auto &) { m.end()++; }) &&
+         Alike([](auto &m, auto &) { --m.begin(); }) &&
+         Alike([](auto &m, auto &) { m.cbegin()--; }) &&
+         Alike([](auto &m, auto &) { m.at(-1); }) &&
+         Alike([](auto &m, auto &) { const auto &constm = m; constm[-1]; });
+}
+
+int main() {
+  if (!check1()) cout << "Test 1 Failed......" << endl; else cout << "Test 1 Passed!" << endl;
+  if (!check2()) cout << "Test 2 Failed......" << endl; else cout << "Test 2 Passed!" << endl;
+  if (!check3()) cout << "Test 3 Failed......" << endl; else cout << "Test 3 Passed!" << endl;
+  if (!check4()) cout << "Test 4 Failed......" << endl; else cout << "Test 4 Passed!" << endl;
+  if (!check5()) cout << "Test 5 Failed......" << endl; else cout << "Test 5 Passed!" << endl;
+  return 0;
+}
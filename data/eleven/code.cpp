@@ -0,0 +1,208 @@
+// persistent_map: every version stays as it was when it was made, checked
+// against std::map copies; nodes are counted by the allocator, so a version
+// dropped too early or never freed shows up (run under -fsanitize=address too)
+#include <iostream>
+#include <map>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include "persistent_map.hpp"
+
+using namespace std;
+
+unsigned Last = 20230330;
+
+int Rand() {
+  Last = Last * 1103515245u + 12345u;
+  return int(Last >> 8);
+}
+
+// nodes alive right now, over every map made with this allocator
+long long Nodes = 0;
+
+template<class T>
+struct Counting {
+  typedef T value_type;
+  Counting() = default;
+  template<class U>
+  Counting(const Counting<U> &) {}
+  T *allocate(std::size_t n) {
+    Nodes += n;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, std::size_t n) {
+    Nodes -= n;
+    std::allocator<T>().deallocate(p, n);
+  }
+  template<class U>
+  bool operator==(const Counting<U> &) const {
+    return true;
+  }
+  template<class U>
+  bool operator!=(const Counting<U> &) const {
+    return false;
+  }
+};
+
+// descending or ascending, chosen when the map is made, so every version has to keep it
+struct Direction {
+  bool down;
+  explicit Direction(bool _down = false) : down(_down) {}
+  bool operator()(int one, int another) const {
+    return down ? another < one : one < another;
+  }
+};
+
+typedef sjtu::persistent_map<int, int, Direction, Counting<sjtu::pair<const int, int>>> Map;
+typedef std::map<int, int, Direction> StdMap;
+
+// same elements in the same order, walked both ways, and found by key
+bool Same(const Map &Q, const StdMap &stdQ) {
+  if (Q.size() != (int) stdQ.size() || Q.empty() != stdQ.empty()) return false;
+  Map::const_iterator it = Q.cbegin();
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it) {
+    if (it == Q.cend() || it->first != stdit->first || it->second != stdit->second) return false;
+    if (Q.at(stdit->first) != stdit->second || Q.count(stdit->first) != 1) return false;
+  }
+  if (it != Q.cend()) return false;
+  for (auto stdit = stdQ.rbegin(); stdit != stdQ.rend(); ++stdit) {
+    if ((--it)->first != stdit->first) return false;
+  }
+  return it == Q.cbegin();
+}
+
+// one random change to Q, made to stdQ as well
+void Change(Map &Q, StdMap &stdQ, int range) {
+  int key = Rand() % range, value = Rand(), kind = Rand() % 4;
+  if (kind == 0) {
+    Q = Q.insert(sjtu::pair<const int, int>(key, value));
+    stdQ.insert(std::make_pair(key, value));
+  } else if (kind == 1) {
+    Q = Q.insert_or_assign(key, value);
+    stdQ[key] = value;
+  } else {
+    Q = Q.erase(key);
+    stdQ.erase(key);
+  }
+}
+
+/**
+ * snapshots taken every few changes to the live map, which keeps going;
+ * in the end each one still holds just what the live map held then
+ */
+bool check1() {
+  for (int down = 0; down < 2; ++down) {
+    Map Q{Direction(down)};
+    StdMap stdQ{Direction(down)};
+    std::vector<Map> snapshots;
+    std::vector<StdMap> stdSnapshots;
+    for (int i = 0; i < 20000; ++i) {
+      Change(Q, stdQ, 3000);
+      if (i % 500 == 0) snapshots.push_back(Q), stdSnapshots.push_back(stdQ);
+    }
+    if (!Same(Q, stdQ)) return false;
+    for (std::size_t i = 0; i < snapshots.size(); ++i) {
+      if (!Same(snapshots[i], stdSnapshots[i])) return false;
+    }
+  }
+  return Nodes == 0;
+}
+
+// the live map alone, against std::map after every change, lookups of missing keys throw
+bool check2() {
+  Map Q;
+  StdMap stdQ;
+  for (int i = 0; i < 5000; ++i) {
+    Change(Q, stdQ, 500);
+    if (i % 50 == 0 && !Same(Q, stdQ)) return false;
+    int key = Rand() % 600;
+    if ((Q.find(key) == Q.cend()) != !stdQ.count(key)) return false;
+    try {
+      if (Q[key] != stdQ.at(key)) return false;
+    } catch (sjtu::index_out_of_bound &) {
+      if (stdQ.count(key)) return false;
+    } catch (std::out_of_range &) {
+      return false;
+    }
+  }
+  // a version with nothing changed in it shares everything with this one
+  long long before = Nodes;
+  Map same = Q.erase(-1);
+  if (!stdQ.empty()) same = same.insert(sjtu::pair<const int, int>(stdQ.begin()->first, 0));
+  if (Nodes != before || !Same(same, stdQ)) return false;
+  Map empty = Q.clear();
+  return empty.empty() && empty.cbegin() == empty.cend() && Same(Q, stdQ) && Nodes == before;
+}
+
+/**
+ * snapshots dropped first to last, last to first and at random: the others
+ * keep their contents, and once only one version is left it holds exactly
+ * its own nodes
+ */
+bool Drop(int order) {
+  Map Q;
+  StdMap stdQ;
+  std::vector<Map> snapshots;
+  std::vector<StdMap> stdSnapshots;
+  for (int i = 0; i < 6000; ++i) {
+    Change(Q, stdQ, 2000);
+    if (i % 300 == 0) snapshots.push_back(Q), stdSnapshots.push_back(stdQ);
+  }
+  std::vector<int> ids;
+  for (std::size_t i = 0; i < snapshots.size(); ++i) ids.push_back(i);
+  if (order == 1) std::reverse(ids.begin(), ids.end());
+  if (order == 2) {
+    for (int i = ids.size() - 1; i > 0; --i) std::swap(ids[i], ids[Rand() % (i + 1)]);
+  }
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    snapshots[ids[i]] = Map();
+    for (std::size_t j = i + 1; j < ids.size(); ++j) {
+      if (!Same(snapshots[ids[j]], stdSnapshots[ids[j]])) return false;
+    }
+    if (!Same(Q, stdQ)) return false;
+  }
+  if (Nodes != (long long) stdQ.size()) return false;
+  // and the live one goes last, or first, leaving a snapshot of it alone
+  Map last(Q);
+  if (order % 2) std::swap(Q, last);
+  Q = Map();
+  return Same(last, stdQ) && Nodes == (long long) stdQ.size();
+}
+
+bool check3() {
+  return Drop(0) && Nodes == 0 && Drop(1) && Nodes == 0 && Drop(2) && Nodes == 0;
+}
+
+/**
+ * iterators of a snapshot stay valid while newer versions are made and the
+ * map they came from is reassigned, as long as the snapshot lives
+ */
+bool check4() {
+  Map Q;
+  StdMap stdQ;
+  for (int i = 0; i < 1000; ++i) Change(Q, stdQ, 1000);
+  Map snapshot(Q);
+  Map::const_iterator it = snapshot.cbegin(), mid = snapshot.find(stdQ.rbegin()->first);
+  for (int i = 0; i < 5000; ++i) Change(Q, stdQ, 1000);
+  Q = Q.clear();
+  StdMap stdSnapshot;
+  for (Map::const_iterator now = it; now != snapshot.cend(); ++now) stdSnapshot.insert(std::make_pair(now->first, now->second));
+  if (!Same(snapshot, stdSnapshot) || ++mid != snapshot.cend()) return false;
+  // moving a version moves its nodes along, nothing is copied or freed
+  long long before = Nodes;
+  Map moved(std::move(snapshot));
+  if (!snapshot.empty() || Nodes != before || !Same(moved, stdSnapshot)) return false;
+  Map assigned;
+  assigned = std::move(moved);
+  return moved.empty() && Nodes == before && Same(assigned, stdSnapshot) && !assigned.key_comp()(1, 0) &&
+         assigned.value_comp()(*assigned.cbegin(), *--assigned.cend());
+}
+
+int main() {
+  if (!check1()) cout << "Test 1 Failed......" << endl; else cout << "Test 1 Passed!" << endl;
+  if (!check2()) cout << "Test 2 Failed......" << endl; else cout << "Test 2 Passed!" << endl;
+  if (!check3()) cout << "Test 3 Failed......" << endl; else cout << "Test 3 Passed!" << endl;
+  if (!check4()) cout << "Test 4 Failed......" << endl; else cout << "Test 4 Passed!" << endl;
+  return 0;
+}
@@ -0,0 +1,200 @@
+// cow_map: copies share a tree until one of them is changed, checked against std::map
+// every check runs on the AVL and the red-black tree
+#include <iostream>
+#include <map>
+#include <iterator>
+#include <cstdio>
+#include "cow_map.hpp"
+
+using namespace std;
+
+using sjtu::red_black_policy;
+
+unsigned Last = 20230327;
+
+int Rand() {
+  Last = Last * 1103515245u + 12345u;
+  return int(Last >> 8);
+}
+
+template<class Policy>
+using Map = sjtu::cow_map<int, int, std::less<int>, std::allocator<sjtu::pair<const int, int>>, Policy>;
+
+// same elements in the same order, only read through the const interface
+template<class Policy>
+bool Same(const Map<Policy> &Q, const std::map<int, int> &stdQ) {
+  if (Q.size() != (int) stdQ.size() || Q.empty() != stdQ.empty()) return false;
+  typename Map<Policy>::const_iterator it = Q.cbegin();
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it) {
+    if (it == Q.cend() || it->first != stdit->first || it->second != stdit->second) return false;
+  }
+  return it == Q.cend();
+}
+
+template<class Policy>
+void Fill(Map<Policy> &Q, std::map<int, int> &stdQ, int n, int range) {
+  for (int i = 0; i < n; ++i) {
+    int key = Rand() % range, value = Rand();
+    Q[key] = value, stdQ[key] = value;
+  }
+}
+
+template<class Policy>
+bool CopyThenWrite() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 2000, 5000);
+  // each kind of write, on the copy and on the original
+  for (int kind = 0; kind < 6; ++kind) {
+    for (int side = 0; side < 2; ++side) {
+      Map<Policy> copy(Q);
+      std::map<int, int> stdCopy(stdQ);
+      Map<Policy> &changed = side ? copy : Q, &kept = side ? Q : copy;
+      std::map<int, int> &stdChanged = side ? stdCopy : stdQ, &stdKept = side ? stdQ : stdCopy;
+      int key = Rand() % 5000, value = Rand();
+      if (kind == 0) {
+        changed[key] = value, stdChanged[key] = value;
+      } else if (kind == 1) {
+        changed.insert(sjtu::pair<const int, int>(key, value)), stdChanged.insert(std::make_pair(key, value));
+      } else if (kind == 2) {
+        changed.erase(key), stdChanged.erase(key);
+      } else if (kind == 3) {
+        // a write through an iterator handed out by the non-const find
+        key = stdChanged.begin()->first;
+        changed.find(key)->second = value, stdChanged[key] = value;
+      } else if (kind == 4) {
+        changed.at(key = stdChanged.rbegin()->first) = value, stdChanged[key] = value;
+      } else {
+        changed.try_emplace(key, value), stdChanged.emplace(key, value);
+      }
+      if (!Same(changed, stdChanged) || !Same(kept, stdKept)) return false;
+    }
+  }
+  return true;
+}
+
+template<class Policy>
+bool SharedFlag() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 500, 1000);
+  if (Q.is_shared()) return false;
+  Map<Policy> copy(Q), another;
+  another = copy;
+  if (!Q.is_shared() || !copy.is_shared() || !another.is_shared()) return false;
+  // reads through const references keep sharing
+  const Map<Policy> &view = copy;
+  if (view.find(stdQ.begin()->first) == view.cend() || view.count(-1) || view.cbegin() == view.cend()) return false;
+  if (!copy.is_shared()) return false;
+  copy[-1] = 1;
+  if (copy.is_shared() || !Q.is_shared() || !another.is_shared()) return false;
+  another.erase(stdQ.begin()->first);
+  if (another.is_shared() || Q.is_shared()) return false;
+  stdQ[-1] = 1;
+  if (!Same(copy, stdQ)) return false;
+  stdQ.erase(-1);
+  if (!Same(Q, stdQ)) return false;
+  stdQ.erase(stdQ.begin());
+  if (!Same(another, stdQ)) return false;
+  // moving a shared map moves the sharing along
+  Map<Policy> first(Q), second(std::move(first));
+  return Q.is_shared() && second.is_shared() && !first.is_shared() && first.empty();
+}
+
+template<class Policy>
+bool OldIterators() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 1000, 3000);
+  for (int round = 0; round < 100; ++round) {
+    // a pos taken before the copy, handed to the call that clones
+    auto stdit = stdQ.begin();
+    std::advance(stdit, Rand() % stdQ.size());
+    int key = stdit->first;
+    typename Map<Policy>::iterator pos = Q.find(key);
+    Map<Policy> copy(Q);
+    std::map<int, int> stdCopy(stdQ);
+    auto next = Q.erase(pos);
+    auto stdNext = stdQ.erase(stdQ.find(key));
+    if (stdNext == stdQ.end() ? next != Q.end() : next->first != stdNext->first) return false;
+    if (!Same(Q, stdQ) || !Same(copy, stdCopy)) return false;
+    // now pos belongs to copy, erasing it from Q again is wrong
+    typename Map<Policy>::iterator stale = copy.find(key);
+    Map<Policy> other(copy);
+    other[-5] = 5;
+    try {
+      Q.erase(stale);
+      return false;
+    } catch (sjtu::invalid_iterator &) {}
+    if (!Same(Q, stdQ) || !Same(copy, stdCopy)) return false;
+    // the end() of any map can't be erased, shared or not
+    Map<Policy> shared(Q);
+    try {
+      Q.erase(other.end());
+      return false;
+    } catch (sjtu::invalid_iterator &) {}
+    if (!Same(Q, stdQ) || !Same(shared, stdQ)) return false;
+    // an old hint is dropped, the value still goes where it belongs
+    typename Map<Policy>::iterator hint = Q.lower_bound(key);
+    Map<Policy> before(Q);
+    int value = Rand();
+    auto done = Q.insert(hint, sjtu::pair<const int, int>(key, value));
+    stdQ.insert(std::make_pair(key, value));
+    if (done->first != key || done->second != value || !Same(Q, stdQ)) return false;
+    std::map<int, int> stdBefore(stdQ);
+    stdBefore.erase(key);
+    if (!Same(before, stdBefore)) return false;
+    // and an rvalue with a hint from before the copy as well
+    Map<Policy> again(Q);
+    key = 3000 + round;
+    Q.insert(hint, sjtu::pair<const int, int>(key, key));
+    stdQ.insert(std::make_pair(key, key));
+    if (!Same(Q, stdQ)) return false;
+    stdQ.erase(key);
+    if (!Same(again, stdQ)) return false;
+    stdQ[key] = key;
+  }
+  return true;
+}
+
+template<class Policy>
+bool ClearShared() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 1000, 3000);
+  Map<Policy> copy(Q), third(Q);
+  copy.clear();
+  if (!copy.empty() || copy.is_shared() || !Same(Q, stdQ) || !Same(third, stdQ) || !Q.is_shared()) return false;
+  // the cleared copy is a map of its own
+  copy[1] = 2;
+  Q.clear();
+  if (Q.is_shared() || !Q.empty() || !Same(third, stdQ) || third.is_shared()) return false;
+  std::map<int, int> one{{1, 2}};
+  if (!Same(copy, one)) return false;
+  third.clear();
+  return third.empty() && !third.is_shared() && Same(copy, one);
+}
+
+bool check1() {
+  return CopyThenWrite<sjtu::map_policy>() && CopyThenWrite<red_black_policy>();
+}
+
+bool check2() {
+  return SharedFlag<sjtu::map_policy>() && SharedFlag<red_black_policy>();
+}
+
+bool check3() {
+  return OldIterators<sjtu::map_policy>() && OldIterators<red_black_policy>();
+}
+
+bool check4() {
+  return ClearShared<sjtu::map_policy>() && ClearShared<red_black_policy>();
+}
+
+int main() {
+  if (!check1()) cout << "Test 1 Failed......" << endl; else cout << "Test 1 Passed!" << endl;
+  if (!check2()) cout << "Test 2 Failed......" << endl; else cout << "Test 2 Passed!" << endl;
+  if (!check3()) cout << "Test 3 Failed......" << endl; else cout << "Test 3 Passed!" << endl;
+  if (!check4()) cout << "Test 4 Failed......" << endl; else cout << "Test 4 Passed!" << endl;
+  return 0;
+}
@@ -0,0 +1,250 @@
+// multi-threaded stress test of concurrent_map and sharded_map
+// every thread writes its own keys only, so the final contents have to be
+// those of replaying the threads one after another on a single-threaded map;
+// the same ops also run on a std::map behind one mutex, which has to agree
+#include <iostream>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "map.hpp"
+#include "concurrent_map.hpp"
+#include "sharded_map.hpp"
+
+using namespace std;
+
+const int kThreads = 4, kOps = 30000, kKeys = 4096;
+
+struct Op {
+  int kind; // 0 read, 1 write, 2 erase
+  int key;
+};
+
+int ValueOf(int key, int op) {
+  return key * 64 + (op & 63);
+}
+
+vector<Op> OpsOf(int id, int write_percent) {
+  mt19937 rng(19260817 + id);
+  vector<Op> result(kOps);
+  for (int i = 0; i < kOps; ++i) {
+    int roll = rng() % 100, key = rng() % kKeys;
+    if (roll >= write_percent) {
+      result[i] = Op{0, key};
+    } else {
+      key = key - key % kThreads + id;
+      result[i] = Op{roll % 4 ? 1 : 2, key};
+    }
+  }
+  return result;
+}
+
+class LockedMap {
+ private:
+  mutex lock;
+  std::map<int, int> m;
+ public:
+  bool find(int key, int &obj) {
+    lock_guard<mutex> guard(lock);
+    auto it = m.find(key);
+    if (it == m.end()) return false;
+    obj = it->second;
+    return true;
+  }
+  void insert_or_assign(int key, int obj) {
+    lock_guard<mutex> guard(lock);
+    m[key] = obj;
+  }
+  void erase(int key) {
+    lock_guard<mutex> guard(lock);
+    m.erase(key);
+  }
+  template<class Visit>
+  void for_each(Visit visit) {
+    lock_guard<mutex> guard(lock);
+    for (auto &value : m) visit(sjtu::pair<const int, int>(value.first, value.second));
+  }
+};
+
+// runs all the threads at once, false if a read saw a value of another key
+template<class Map>
+bool RunThreads(Map &m, const vector<vector<Op>> &ops) {
+  atomic<bool> go(false);
+  atomic<int> wrong(0);
+  vector<thread> threads;
+  for (const vector<Op> &mine : ops) {
+    threads.emplace_back([&m, &mine, &go, &wrong] {
+      while (!go.load()) this_thread::yield();
+      for (int i = 0; i < (int) mine.size(); ++i) {
+        int obj;
+        if (mine[i].kind == 0) {
+          if (m.find(mine[i].key, obj) && obj / 64 != mine[i].key) ++wrong;
+        } else if (mine[i].kind == 1) {
+          m.insert_or_assign(mine[i].key, ValueOf(mine[i].key, i));
+        } else {
+          m.erase(mine[i].key);
+        }
+      }
+    });
+  }
+  go = true;
+  for (thread &t : threads) t.join();
+  return !wrong;
+}
+
+sjtu::map<int, int> Replay(const vector<vector<Op>> &ops) {
+  sjtu::map<int, int> m;
+  for (const vector<Op> &mine : ops) {
+    for (int i = 0; i < (int) mine.size(); ++i) {
+      if (mine[i].kind == 1) {
+        m[mine[i].key] = ValueOf(mine[i].key, i);
+      } else if (mine[i].kind == 2) {
+        m.erase(mine[i].key);
+      }
+    }
+  }
+  return m;
+}
+
+template<class Map>
+bool SameAs(Map &m, const sjtu::map<int, int> &expected) {
+  auto it = expected.cbegin();
+  bool same = true;
+  m.for_each([&](const sjtu::pair<const int, int> &value) {
+    if (it == expected.cend() || (*it).first != value.first || (*it).second != value.second) {
+      same = false;
+      return;
+    }
+    ++it;
+  });
+  return same && it == expected.cend();
+}
+
+template<class Map>
+bool Check(Map &m, int write_percent) {
+  vector<vector<Op>> all;
+  for (int i = 0; i < kThreads; ++i) all.push_back(OpsOf(i, write_percent));
+  sjtu::map<int, int> expected = Replay(all);
+  return RunThreads(m, all) && SameAs(m, expected);
+}
+
+int expected_size(int write_percent) {
+  vector<vector<Op>> all;
+  for (int i = 0; i < kThreads; ++i) all.push_back(OpsOf(i, write_percent));
+  return Replay(all).size();
+}
+
+bool check1() { // concurrent_map
+  for (int write_percent : {10, 50, 100}) {
+    sjtu::concurrent_map<int, int> m;
+    if (!Check(m, write_percent) || m.size() != expected_size(write_percent)) return false;
+  }
+  return true;
+}
+
+bool check2() { // sharded_map by hash
+  for (int write_percent : {10, 50, 100}) {
+    sjtu::sharded_map<int, int> m;
+    if (!Check(m, write_percent) || m.size() != expected_size(write_percent)) return false;
+  }
+  return true;
+}
+
+bool check3() { // sharded_map by range
+  vector<int> splits;
+  for (int i = 1; i < 16; ++i) splits.push_back(kKeys / 16 * i);
+  for (int write_percent : {10, 50, 100}) {
+    sjtu::sharded_map<int, int, std::less<int>, 16, sjtu::range_partition<int, 16>> m{sjtu::range_partition<int, 16>(splits)};
+    if (!Check(m, write_percent) || m.size() != expected_size(write_percent)) return false;
+  }
+  return true;
+}
+
+bool check4() { // std::map behind a mutex, the baseline the others are measured against
+  for (int write_percent : {10, 50, 100}) {
+    LockedMap m;
+    if (!Check(m, write_percent)) return false;
+  }
+  return true;
+}
+
+bool check5() { // insert and erase tell what happened, whatever the interleaving
+  sjtu::concurrent_map<int, int> m;
+  atomic<int> inserted(0), erased(0);
+  vector<thread> threads;
+  for (int id = 0; id < kThreads; ++id) {
+    threads.emplace_back([&m, &inserted, &erased, id] {
+      for (int round = 0; round < 3; ++round) {
+        for (int key = id; key < kKeys; key += kThreads) inserted += m.insert(sjtu::pair<const int, int>(key, key * 64));
+        for (int key = id; key < kKeys; key += 2 * kThreads) erased += m.erase(key);
+      }
+    });
+  }
+  for (thread &t : threads) t.join();
+  if (inserted - erased != m.size()) return false;
+  int seen = 0;
+  bool ok = true;
+  m.for_each([&](const sjtu::pair<const int, int> &value) {
+    if (value.second != value.first * 64 || value.first % (2 * kThreads) < kThreads) ok = false;
+    ++seen;
+  });
+  return ok && seen == kKeys / 2;
+}
+
+bool check6() { // concurrent_map with its lanes cut by range, and with a single lane
+  vector<int> splits;
+  for (int i = 1; i < 16; ++i) splits.push_back(kKeys / 16 * i);
+  for (int write_percent : {10, 50, 100}) {
+    sjtu::concurrent_map<int, int, std::less<int>, 16, sjtu::range_partition<int, 16>> m{sjtu::range_partition<int, 16>(splits)};
+    if (!Check(m, write_percent) || m.size() != expected_size(write_percent)) return false;
+    sjtu::concurrent_map<int, int, std::less<int>, 1> one;
+    if (!Check(one, write_percent) || one.size() != expected_size(write_percent)) return false;
+  }
+  return true;
+}
+
+// descending or ascending, chosen when the map is made, so the map has to keep it
+struct Direction {
+  bool down;
+  explicit Direction(bool _down = false) : down(_down) {}
+  bool operator()(int one, int another) const {
+    return down ? another < one : one < another;
+  }
+};
+
+bool check7() { // every lane orders by the comparator the map was made with, and so does for_each
+  sjtu::concurrent_map<int, int, Direction> m{Direction(true)};
+  vector<int> splits;
+  for (int i = 15; i >= 1; --i) splits.push_back(kKeys / 16 * i);
+  sjtu::concurrent_map<int, int, std::greater<int>, 16, sjtu::range_partition<int, 16, std::greater<int>>>
+      ranged{sjtu::range_partition<int, 16, std::greater<int>>(splits, std::greater<int>())};
+  for (int i = 0; i < kKeys; ++i) {
+    int key = (i * 37) % kKeys;
+    m.insert_or_assign(key, key), ranged.insert_or_assign(key, key);
+  }
+  int last = kKeys, rangedLast = kKeys, seen = 0, rangedSeen = 0;
+  bool ok = true;
+  m.for_each([&](const sjtu::pair<const int, int> &value) {
+    if (value.first >= last || value.second != value.first) ok = false;
+    last = value.first, ++seen;
+  });
+  ranged.for_each([&](const sjtu::pair<const int, int> &value) {
+    if (value.first >= rangedLast) ok = false;
+    rangedLast = value.first, ++rangedSeen;
+  });
+  return ok && seen == kKeys && rangedSeen == kKeys && m.key_comp()(2, 1) && !m.key_comp()(1, 2);
+}
+
+int main() {
+  if (!check1()) cout << "Test 1 Failed......" << endl; else cout << "Test 1 Passed!" << endl;
+  if (!check2()) cout << "Test 2 Failed......" << endl; else cout << "Test 2 Passed!" << endl;
+  if (!check3()) cout << "Test 3 Failed......" << endl; else cout << "Test 3 Passed!" << endl;
+  if (!check4()) cout << "Test 4 Failed......" << endl; else cout << "Test 4 Passed!" << endl;
+  if (!check5()) cout << "Test 5 Failed......" << endl; else cout << "Test 5 Passed!" << endl;
+  if (!check6()) cout << "Test 6 Failed......" << endl; else cout << "Test 6 Passed!" << endl;
+  if (!check7()) cout << "Test 7 Failed......" << endl; else cout << "Test 7 Passed!" << endl;
+  return 0;
+}
@@ -0,0 +1,704 @@
+// the ordered queries and bulk operations of sjtu::map, checked against std::map
+// every check runs on the AVL and the red-black tree, with order_statistics
+// and threaded switched on and off
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <iterator>
+#include <tuple>
+#include <cstdio>
+#include "map.hpp"
+
+using namespace std;
+
+using sjtu::order_statistics_policy;
+using sjtu::threaded_policy;
+using sjtu::red_black_policy;
+struct rb_all : sjtu::map_policy {
+  using order_statistics = sjtu::my_true_type;
+  using threaded = sjtu::my_true_type;
+  using balance = sjtu::red_black_tree;
+};
+
+unsigned Last = 20230326;
+
+int Rand() {
+  Last = Last * 1103515245u + 12345u;
+  return int(Last >> 8);
+}
+
+template<class Policy>
+using Map = sjtu::map<int, int, std::less<int>, std::allocator<sjtu::pair<const int, int>>, Policy>;
+
+// same elements in the same order, walked both ways
+template<class Policy>
+bool Same(Map<Policy> &Q, const std::map<int, int> &stdQ) {
+  if (Q.size() != (int) stdQ.size() || Q.empty() != stdQ.empty()) return false;
+  typename Map<Policy>::iterator it = Q.begin();
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it) {
+    if (it == Q.end() || it->first != stdit->first || it->second != stdit->second) return false;
+  }
+  if (it != Q.end()) return false;
+  for (auto stdit = stdQ.rbegin(); stdit != stdQ.rend(); ++stdit) {
+    --it;
+    if (it->first != stdit->first) return false;
+  }
+  return it == Q.begin();
+}
+
+template<class Policy>
+void Fill(Map<Policy> &Q, std::map<int, int> &stdQ, int n, int range) {
+  for (int i = 0; i < n; ++i) {
+    int key = Rand() % range, value = Rand();
+    Q[key] = value, stdQ[key] = value;
+  }
+}
+
+template<class Policy>
+bool NthRank() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 3000, 10000);
+  const Map<Policy> &constQ = Q;
+  int k = 0;
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++k) {
+    if (Q.nth(k)->first != stdit->first || constQ.nth(k)->second != stdit->second) return false;
+    if (Q.rank(stdit->first) != k || Q.rank(stdit->first + 1) != k + 1) return false;
+  }
+  if (Q.nth(-1) != Q.end() || Q.nth(Q.size()) != Q.end()) return false;
+  for (int i = 0; i < 2000; ++i) {
+    int key = Rand() % 10020 - 10;
+    if (Q.rank(key) != (int) std::distance(stdQ.begin(), stdQ.lower_bound(key))) return false;
+  }
+  return true;
+}
+
+template<class Policy>
+bool Jumps() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 2000, 5000);
+  int n = Q.size();
+  for (int i = 0; i < 2000; ++i) {
+    int from = Rand() % (n + 1), to = Rand() % (n + 1);
+    typename Map<Policy>::iterator it = Q.begin();
+    it += from;
+    typename Map<Policy>::const_iterator cit = Q.cbegin();
+    cit += to;
+    auto stdfrom = std::next(stdQ.begin(), from), stdto = std::next(stdQ.begin(), to);
+    if ((from == n) != (it == Q.end()) || (from < n && it->first != stdfrom->first)) return false;
+    if (it - Q.begin() != std::distance(stdQ.begin(), stdfrom)) return false;
+    if (cit - Q.cbegin() != std::distance(stdQ.begin(), stdto)) return false;
+    it -= from - to;
+    if (it != Q.nth(to) || (to < n && it->first != stdto->first)) return false;
+  }
+  try {
+    typename Map<Policy>::iterator it = Q.begin();
+    it -= 1;
+    return false;
+  } catch (...) {}
+  try {
+    typename Map<Policy>::iterator it = Q.end();
+    it += 1;
+    return false;
+  } catch (...) {}
+  return true;
+}
+
+template<class Policy>
+bool Bounds() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  const Map<Policy> &constQ = Q;
+  if (Q.lower_bound(1) != Q.end() || constQ.upper_bound(1) != constQ.cend() || Q.count_range(0, 10)) return false;
+  Fill(Q, stdQ, 2000, 6000);
+  for (int i = 0; i < 3000; ++i) {
+    int key = Rand() % 6040 - 20, hi = key + Rand() % 300 - 50;
+    auto stdlo = stdQ.lower_bound(key), stdup = stdQ.upper_bound(key);
+    typename Map<Policy>::iterator lo = Q.lower_bound(key), up = Q.upper_bound(key);
+    typename Map<Policy>::const_iterator clo = constQ.lower_bound(key), cup = constQ.upper_bound(key);
+    if (std::distance(stdQ.begin(), stdlo) != lo - Q.begin()) return false;
+    if (std::distance(stdQ.begin(), stdup) != up - Q.begin()) return false;
+    if (std::distance(stdQ.begin(), stdlo) != clo - constQ.cbegin()) return false;
+    if (std::distance(stdQ.begin(), stdup) != cup - constQ.cbegin()) return false;
+    if (stdlo != stdQ.end() && (lo->first != stdlo->first || clo->first != stdlo->first)) return false;
+    if (stdup != stdQ.end() && (up->first != stdup->first || cup->first != stdup->first)) return false;
+    sjtu::pair<typename Map<Policy>::iterator, typename Map<Policy>::iterator> range = Q.equal_range(key);
+    sjtu::pair<typename Map<Policy>::const_iterator, typename Map<Policy>::const_iterator> crange = constQ.equal_range(key);
+    if (range.first != lo || range.second != up || crange.first != clo || crange.second != cup) return false;
+    if (range.second - range.first != (int) stdQ.count(key)) return false;
+    int expected = hi <= key ? 0 : (int) std::distance(stdQ.lower_bound(key), stdQ.lower_bound(hi));
+    if (Q.count_range(key, hi) != expected) return false;
+  }
+  return true;
+}
+
+template<class Policy>
+bool Erase() {
+  Map<Policy> Q;
+  std::map<int, int> stdQ;
+  Fill(Q, stdQ, 3000, 5000);
+  // erase(pos) hands back the element after pos
+  for (int i = 0; i < 300; ++i) {
+    int key = Rand() % 5000;
+    auto stdit = stdQ.lower_bound(key);
+    if (stdit == stdQ.end()) continue;
+    typename Map<Policy>::iterator next = Q.erase(Q.find(stdit->first));
+    stdit = stdQ.erase(stdit);
+    if ((stdit == stdQ.end()) != (next == Q.end()) || (stdit != stdQ.end() && next->first != stdit->first)) return false;
+  }
+  // erase(key) tells how many went
+  for (int i = 0; i < 300; ++i) {
+    int key = Rand() % 5000;
+    if (Q.erase(key) != (int) stdQ.erase(key)) return false;
+  }
+  if (!Same(Q, stdQ)) return false;
+  // erase(first, last): empty ranges, short ones, long ones and up to end()
+  for (int i = 0; i < 200; ++i) {
+    int key = Rand() % 5000, span = i % 3 ? Rand() % 40 : Rand() % 3000;
+    typename Map<Policy>::iterator first = Q.lower_bound(key), last = Q.lower_bound(key + span);
+    auto stdfirst = stdQ.lower_bound(key), stdlast = stdQ.lower_bound(key + span);
+    if (i % 10 == 0) last = Q.end(), stdlast = stdQ.end();
+    if (i % 10 == 5) last = first, stdlast = stdfirst;
+    typename Map<Policy>::iterator after = Q.erase(first, last);
+    auto stdafter = stdQ.erase(stdfirst, stdlast);
+    if ((stdafter == stdQ.end()) != (after == Q.end()) || (stdafter != stdQ.end() && after->first != stdafter->first)) return false;
+    if (!Same(Q, stdQ)) return false;
+    if (Q.size() < 500) Fill(Q, stdQ, 2000, 5000);
+  }
+  // the nodes left still work with the rest of the map
+  Fill(Q, stdQ, 500, 5000);
+  for (int i = 0; i < (int) stdQ.size(); i += 37) {
+    if (Q.nth(i)->first != std::next(stdQ.begin(), i)->first) return false;
+  }
+  // a range the wrong way round throws and erases nothing
+  if (Q.size() > 2) {
+    int before = Q.size();
+    try {
+      Q.erase(Q.nth(2), Q.nth(1));
+      return false;
+    } catch (...) {}
+    if (Q.size() != before || !Same(Q, stdQ)) return false;
+  }
+  // everything
+  if (Q.erase(Q.begin(), Q.end()) != Q.end() || !Q.empty() || Q.begin() != Q.end()) return false;
+  stdQ.clear();
+  if (Q.erase(Q.begin(), Q.end()) != Q.end()) return false;
+  Fill(Q, stdQ, 100, 1000);
+  return Same(Q, stdQ);
+}
+
+// Same, plus nth and rank at a few places
+template<class Policy>
+bool Ranked(Map<Policy> &Q, const std::map<int, int> &stdQ) {
+  if (!Same(Q, stdQ)) return false;
+  int k = 0;
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++k) {
+    if (k % 13) continue;
+    if (Q.nth(k)->first != stdit->first || Q.rank(stdit->first) != k) return false;
+  }
+  return true;
+}
+
+template<class Policy>
+bool SplitJoin() {
+  for (int round = 0; round < 60; ++round) {
+    Map<Policy> Q;
+    std::map<int, int> stdQ;
+    int range = Rand() % 4000 + 1;
+    Fill(Q, stdQ, round % 5 ? Rand() % 1500 : Rand() % 5, range);
+    // split at a key that may or may not be there, or outside all keys
+    int key = Rand() % (range + 20) - 10;
+    Map<Policy> R = Q.split(key);
+    std::map<int, int> stdR(stdQ.lower_bound(key), stdQ.end());
+    stdQ.erase(stdQ.lower_bound(key), stdQ.end());
+    if (!Ranked(Q, stdQ) || !Ranked(R, stdR)) return false;
+    // both halves keep working on their own
+    for (int i = 0; i < 50; ++i) {
+      int one = Rand() % range, value = Rand();
+      if (one < key) {
+        Q[one] = value, stdQ[one] = value;
+      } else {
+        R[one] = value, stdR[one] = value;
+      }
+      one = Rand() % range;
+      if (Q.erase(one) != (int) stdQ.erase(one) || R.erase(one) != (int) stdR.erase(one)) return false;
+    }
+    if (!Ranked(Q, stdQ) || !Ranked(R, stdR)) return false;
+    // and join back in either order
+    if (round % 2) {
+      Q.join(R);
+    } else {
+      R.join(Q);
+      Q.swap(R);
+    }
+    stdQ.insert(stdR.begin(), stdR.end());
+    stdR.clear();
+    if (!Ranked(Q, stdQ) || !Ranked(R, stdR)) return false;
+    R[1] = 1, stdR[1] = 1;
+    if (!Ranked(R, stdR)) return false;
+  }
+  // joins of trees of very different heights
+  for (int round = 0; round < 40; ++round) {
+    Map<Policy> Q, R;
+    std::map<int, int> stdQ;
+    int small = Rand() % 8, big = Rand() % 3000;
+    if (round % 2) std::swap(small, big);
+    for (int i = 0; i < small; ++i) Q[i] = i, stdQ[i] = i;
+    for (int i = 0; i < big; ++i) R[small + i] = i, stdQ[small + i] = i;
+    if (round % 4 < 2) {
+      Q.join(R);
+      if (!R.empty() || !Ranked(Q, stdQ)) return false;
+    } else {
+      R.join(Q);
+      if (!Q.empty() || !Ranked(R, stdQ)) return false;
+    }
+  }
+  return true;
+}
+
+// what std::map::merge leaves in both maps
+void StdMerge(std::map<int, int> &into, std::map<int, int> &from) {
+  for (auto it = from.begin(); it != from.end();) {
+    if (into.insert(*it).second) {
+      it = from.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+template<class Policy>
+bool Merge() {
+  for (int round = 0; round < 60; ++round) {
+    Map<Policy> Q, R;
+    std::map<int, int> stdQ, stdR;
+    int range = Rand() % 5000 + 1;
+    Fill(Q, stdQ, Rand() % 1000, range);
+    Fill(R, stdR, round % 3 ? Rand() % 100 : Rand() % 1500, range);
+    // join falls back to merge when the keys overlap
+    if (round % 2) {
+      Q.merge(R);
+    } else {
+      Q.join(R);
+    }
+    StdMerge(stdQ, stdR);
+    // the duplicates stay behind, with their own values
+    if (!Ranked(Q, stdQ) || !Ranked(R, stdR)) return false;
+    for (int i = 0; i < 50; ++i) {
+      int key = Rand() % range, value = Rand();
+      Q[key] = value, stdQ[key] = value;
+      key = Rand() % range;
+      R[key] = value, stdR[key] = value;
+      key = Rand() % range;
+      if (Q.erase(key) != (int) stdQ.erase(key) || R.erase(key) != (int) stdR.erase(key)) return false;
+    }
+    if (!Ranked(Q, stdQ) || !Ranked(R, stdR)) return false;
+    // merging again takes nothing more but what is new
+    R.merge(Q);
+    StdMerge(stdR, stdQ);
+    if (!Ranked(Q, stdQ) || !Ranked(R, stdR)) return false;
+  }
+  return true;
+}
+
+// a mapped value that tells whether it was moved from, and counts how many were built
+struct Tracked {
+  static int built;
+  int value;
+  bool moved;
+  Tracked(int _value = 0) : value(_value), moved(false) {
+    ++built;
+  }
+  Tracked(const Tracked &other) : value(other.value), moved(false) {
+    ++built;
+  }
+  Tracked(Tracked &&other) : value(other.value), moved(false) {
+    other.moved = true;
+    ++built;
+  }
+  Tracked &operator=(const Tracked &other) {
+    value = other.value;
+    return *this;
+  }
+};
+
+int Tracked::built = 0;
+
+template<class Policy>
+using TrackedMap = sjtu::map<int, Tracked, std::less<int>, std::allocator<sjtu::pair<const int, Tracked>>, Policy>;
+
+template<class Policy>
+bool SameTracked(TrackedMap<Policy> &Q, const std::map<int, int> &stdQ) {
+  if (Q.size() != (int) stdQ.size()) return false;
+  typename TrackedMap<Policy>::iterator it = Q.begin();
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it) {
+    if (it == Q.end() || it->first != stdit->first || it->second.value != stdit->second || it->second.moved) return false;
+  }
+  return it == Q.end();
+}
+
+template<class Policy>
+bool Emplace() {
+  TrackedMap<Policy> Q;
+  std::map<int, int> stdQ;
+  for (int i = 0; i < 3000; ++i) {
+    int key = Rand() % 2000, value = Rand(), kind = i % 5;
+    bool there = stdQ.count(key);
+    Tracked arg(value);
+    int built = Tracked::built;
+    typename TrackedMap<Policy>::iterator it;
+    bool inserted;
+    if (kind == 0) {
+      // nothing is built and arg is left alone if key is there
+      auto result = Q.try_emplace(key, std::move(arg));
+      it = result.first, inserted = result.second;
+      if (arg.moved == there || Tracked::built != built + !there) return false;
+    } else if (kind == 1) {
+      int moved_key = key;
+      auto result = Q.try_emplace(std::move(moved_key), value);
+      it = result.first, inserted = result.second;
+      if (Tracked::built != built + !there) return false;
+    } else if (kind == 2) {
+      // the pair is built first, its key is only known then
+      auto result = Q.emplace(key, std::move(arg));
+      it = result.first, inserted = result.second;
+      if (!arg.moved) return false;
+    } else if (kind == 3) {
+      auto result = Q.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value));
+      it = result.first, inserted = result.second;
+    } else {
+      // an rvalue is only moved from when it goes in
+      sjtu::pair<const int, Tracked> pair(key, arg);
+      auto result = Q.insert(std::move(pair));
+      it = result.first, inserted = result.second;
+      if (pair.second.moved == there) return false;
+    }
+    if (inserted == there || it == Q.end() || it->first != key) return false;
+    if (!there) stdQ[key] = value;
+    if (it->second.value != stdQ[key]) return false;
+  }
+  if (!SameTracked(Q, stdQ)) return false;
+  // operator[] with an rvalue key, then the other way round: a value built for a key
+  for (int i = 0; i < 500; ++i) {
+    int key = Rand() % 4000, value = Rand();
+    Q[std::move(key)] = Tracked(value);
+    stdQ[key] = value;
+  }
+  return SameTracked(Q, stdQ);
+}
+
+// std::less<int> that counts its calls
+long long Compares = 0;
+
+struct CountingLess {
+  bool operator()(int one, int another) const {
+    ++Compares;
+    return one < another;
+  }
+};
+
+template<class Policy>
+using CountedMap = sjtu::map<int, int, CountingLess, std::allocator<sjtu::pair<const int, int>>, Policy>;
+
+template<class Policy>
+bool SameCounted(const CountedMap<Policy> &Q, const std::map<int, int> &stdQ) {
+  if (Q.size() != (int) stdQ.size()) return false;
+  typename CountedMap<Policy>::const_iterator it = Q.cbegin();
+  for (auto stdit = stdQ.begin(); stdit != stdQ.end(); ++stdit, ++it) {
+    if (it == Q.cend() || it->first != stdit->first || it->second != stdit->second) return false;
+  }
+  return it == Q.cend() && (Q.empty() || Q.nth(Q.size() - 1) == --Q.cend());
+}
+
+template<class Policy>
+bool HintBuild() {
+  CountedMap<Policy> Q;
+  std::map<int, int> stdQ;
+  // right hints: ascending keys before end(), descending ones before the last one in
+  typename CountedMap<Policy>::const_iterator hint = Q.cend();
+  Compares = 0;
+  for (int i = 0; i < 2000; ++i) {
+    typename CountedMap<Policy>::iterator it = Q.insert(Q.cend(), sjtu::pair<const int, int>(i * 4, i));
+    stdQ[i * 4] = i;
+    if (it->first != i * 4) return false;
+  }
+  for (int i = 0; i < 2000; ++i) {
+    hint = Q.insert(hint, sjtu::pair<const int, int>(-1 - i, i));
+    stdQ[-1 - i] = i;
+    if (hint->first != -1 - i) return false;
+  }
+  // a few compares each, no descent from the root
+  if (Compares > 4000 * 2) return false;
+  if (!SameCounted(Q, stdQ)) return false;
+  // right hints in the middle, wrong ones, end() and keys that are there already
+  for (int i = 0; i < 3000; ++i) {
+    int key = Rand() % 10000 - 2000, value = Rand();
+    typename CountedMap<Policy>::const_iterator at;
+    int kind = i % 4;
+    if (kind == 0) {
+      at = Q.lower_bound(key);
+    } else if (kind == 1) {
+      at = Q.nth(Rand() % Q.size());
+    } else if (kind == 2) {
+      at = Q.cend();
+    } else {
+      at = Q.cbegin();
+    }
+    auto stdit = stdQ.insert(std::make_pair(key, value)).first;
+    sjtu::pair<const int, int> value_pair(key, value);
+    typename CountedMap<Policy>::iterator it = i % 2 ? Q.insert(at, value_pair) : Q.insert(at, std::move(value_pair));
+    if (it->first != key || it->second != stdit->second) return false;
+  }
+  if (!SameCounted(Q, stdQ)) return false;
+  // assign and the range constructor: sorted input is built in linear time,
+  // unsorted input still ends up right, and the first of equal keys wins
+  for (int round = 0; round < 20; ++round) {
+    std::vector<int> keys;
+    int n = Rand() % 3000;
+    for (int i = 0; i < n; ++i) keys.push_back(round % 2 ? i * 2 + Rand() % 2 : Rand() % 5000);
+    std::vector<sjtu::pair<const int, int>> input;
+    std::map<int, int> expected;
+    for (int i = 0; i < n; ++i) {
+      input.push_back(sjtu::pair<const int, int>(keys[i], i));
+      expected.insert(std::make_pair(keys[i], i));
+    }
+    Compares = 0;
+    Q.assign(input.begin(), input.end());
+    if (round % 2 && Compares > 2 * (long long) n) return false;
+    if (!SameCounted(Q, expected)) return false;
+    CountedMap<Policy> R(input.begin(), input.end());
+    if (!SameCounted(R, expected)) return false;
+    // sorted up to some point, then out of order
+    std::sort(keys.begin(), keys.begin() + n / 2);
+    input.clear(), expected.clear();
+    for (int i = 0; i < n; ++i) {
+      input.push_back(sjtu::pair<const int, int>(keys[i], i));
+      expected.insert(std::make_pair(keys[i], i));
+    }
+    Q.assign(input.begin(), input.end());
+    if (!SameCounted(Q, expected)) return false;
+  }
+  return true;
+}
+
+// the same orders once with a three-way compare() (see sjtu::three_way), once as a plain less-than only
+struct ThreeWayDown {
+  bool operator()(int one, int another) const {
+    return one > another;
+  }
+  int compare(int one, int another) const {
+    return (another > one) - (another < one);
+  }
+};
+
+struct LessOnlyDown {
+  bool operator()(int one, int another) const {
+    return one > another;
+  }
+};
+
+// for three_way_less: a three-way function object only
+struct DownOrder {
+  int operator()(int one, int another) const {
+    return (another > one) - (another < one);
+  }
+};
+
+struct LessOnlyString {
+  bool operator()(const std::string &one, const std::string &another) const {
+    return one < another;
+  }
+};
+
+static_assert(std::is_same<sjtu::three_way<ThreeWayDown, int>::tag, sjtu::my_true_type>::value, "compare() should be found");
+static_assert(std::is_same<sjtu::three_way<std::less<std::string>, std::string>::tag, sjtu::my_true_type>::value,
+              "std::less<std::string> should go through string::compare");
+static_assert(std::is_same<sjtu::three_way<LessOnlyDown, int>::tag, sjtu::my_false_type>::value, "no compare() here");
+
+std::string KeyString(int key) {
+  // shared prefixes, so that compare() has more than the first char to look at
+  return std::string(key % 7, 'k') + std::to_string(key);
+}
+
+int KeyOf(int key, int) {
+  return key;
+}
+
+std::string KeyOf(int key, std::string) {
+  return KeyString(key);
+}
+
+// every call gives the same answer on both maps
+template<class Key, class Three, class Two, class Policy>
+bool SameAnswers() {
+  using ThreeMap = sjtu::map<Key, int, Three, std::allocator<sjtu::pair<const Key, int>>, Policy>;
+  using TwoMap = sjtu::map<Key, int, Two, std::allocator<sjtu::pair<const Key, int>>, Policy>;
+  ThreeMap Q;
+  TwoMap R;
+  for (int i = 0; i < 4000; ++i) {
+    Key key = KeyOf(Rand() % 3000, Key());
+    int value = Rand(), kind = i % 6;
+    if (kind == 0) {
+      Q[key] = value, R[key] = value;
+    } else if (kind == 1) {
+      if (Q.insert(sjtu::pair<const Key, int>(key, value)).second != R.insert(sjtu::pair<const Key, int>(key, value)).second) return false;
+    } else if (kind == 2) {
+      if (Q.erase(key) != R.erase(key)) return false;
+    } else if (kind == 3) {
+      if (Q.try_emplace(key, value).second != R.try_emplace(key, value).second) return false;
+    } else if (kind == 4) {
+      if (Q.emplace(key, value).second != R.emplace(key, value).second) return false;
+    } else {
+      typename ThreeMap::iterator it = Q.find(key);
+      typename TwoMap::iterator jt = R.find(key);
+      if ((it == Q.end()) != (jt == R.end()) || Q.count(key) != R.count(key)) return false;
+      if (it != Q.end() && (it->second != jt->second || Q.at(key) != R.at(key))) return false;
+    }
+    typename ThreeMap::iterator lo = Q.lower_bound(key), up = Q.upper_bound(key);
+    typename TwoMap::iterator lo2 = R.lower_bound(key), up2 = R.upper_bound(key);
+    if ((lo == Q.end()) != (lo2 == R.end()) || (lo != Q.end() && !(lo->first == lo2->first))) return false;
+    if ((up == Q.end()) != (up2 == R.end()) || (up != Q.end() && !(up->first == up2->first))) return false;
+  }
+  if (Q.size() != R.size()) return false;
+  typename TwoMap::iterator jt = R.begin();
+  for (typename ThreeMap::iterator it = Q.begin(); it != Q.end(); ++it, ++jt) {
+    if (!(it->first == jt->first) || it->second != jt->second) return false;
+  }
+  return jt == R.end();
+}
+
+template<class Policy>
+bool ThreeWay() {
+  return SameAnswers<int, ThreeWayDown, LessOnlyDown, Policy>() &&
+         SameAnswers<std::string, std::less<std::string>, LessOnlyString, Policy>() &&
+         SameAnswers<int, sjtu::three_way_less<DownOrder>, LessOnlyDown, Policy>();
+}
+
+// a key that counts how many of it were made, looked up by a plain int
+struct NamedKey {
+  static int made;
+  int id;
+  explicit NamedKey(int _id) : id(_id) {
+    ++made;
+  }
+  NamedKey(const NamedKey &other) : id(other.id) {
+    ++made;
+  }
+};
+
+int NamedKey::made = 0;
+
+struct ById {
+  using is_transparent = void;
+  bool operator()(const NamedKey &one, const NamedKey &another) const {
+    return one.id < another.id;
+  }
+  bool operator()(const NamedKey &one, int another) const {
+    return one.id < another;
+  }
+  bool operator()(int one, const NamedKey &another) const {
+    return one < another.id;
+  }
+};
+
+template<class Policy>
+bool Transparent() {
+  using NamedMap = sjtu::map<NamedKey, int, ById, std::allocator<sjtu::pair<const NamedKey, int>>, Policy>;
+  NamedMap Q;
+  const NamedMap &constQ = Q;
+  std::map<int, int> stdQ;
+  for (int i = 0; i < 2000; ++i) {
+    int id = Rand() % 5000, value = Rand();
+    Q.insert(sjtu::pair<const NamedKey, int>(NamedKey(id), value));
+    stdQ.insert(std::make_pair(id, value));
+  }
+  int made = NamedKey::made;
+  for (int i = 0; i < 3000; ++i) {
+    int id = Rand() % 5020 - 10;
+    auto stdit = stdQ.find(id), stdlo = stdQ.lower_bound(id), stdup = stdQ.upper_bound(id);
+    typename NamedMap::iterator it = Q.find(id), lo = Q.lower_bound(id), up = Q.upper_bound(id);
+    typename NamedMap::const_iterator cit = constQ.find(id), clo = constQ.lower_bound(id);
+    if ((it == Q.end()) != (stdit == stdQ.end()) || (cit == constQ.cend()) != (stdit == stdQ.end())) return false;
+    if (stdit != stdQ.end() && (it->second != stdit->second || cit->second != stdit->second || Q.at(id) != stdit->second)) return false;
+    if (Q.count(id) != (int) stdQ.count(id)) return false;
+    if ((lo == Q.end()) != (stdlo == stdQ.end()) || (stdlo != stdQ.end() && (lo->first.id != stdlo->first || clo->first.id != stdlo->first))) return false;
+    if ((up == Q.end()) != (stdup == stdQ.end()) || (stdup != stdQ.end() && up->first.id != stdup->first)) return false;
+    sjtu::pair<typename NamedMap::iterator, typename NamedMap::iterator> range = Q.equal_range(id);
+    if (range.first != lo || range.second != up) return false;
+    if (i % 10 == 0 && Q.erase(id) != (int) stdQ.erase(id)) return false;
+  }
+  // not one key was made for the lookups
+  if (NamedKey::made != made) return false;
+  if (Q.size() != (int) stdQ.size()) return false;
+  auto stdit = stdQ.begin();
+  for (typename NamedMap::iterator it = Q.begin(); it != Q.end(); ++it, ++stdit) {
+    if (it->first.id != stdit->first || it->second != stdit->second) return false;
+  }
+  return true;
+}
+
+bool check1() { // nth and rank
+  return NthRank<sjtu::map_policy>() && NthRank<order_statistics_policy>() && NthRank<threaded_policy>() && NthRank<red_black_policy>() && NthRank<rb_all>();
+}
+
+bool check2() { // iterator jumps and distances
+  return Jumps<sjtu::map_policy>() && Jumps<order_statistics_policy>() && Jumps<threaded_policy>() && Jumps<red_black_policy>() && Jumps<rb_all>();
+}
+
+bool check3() { // lower_bound, upper_bound, equal_range and count_range
+  return Bounds<sjtu::map_policy>() && Bounds<order_statistics_policy>() && Bounds<threaded_policy>() &&
+         Bounds<red_black_policy>() && Bounds<rb_all>();
+}
+
+bool check4() { // erase by iterator, by key and by range
+  return Erase<sjtu::map_policy>() && Erase<order_statistics_policy>() && Erase<threaded_policy>() &&
+         Erase<red_black_policy>() && Erase<rb_all>();
+}
+
+bool check5() { // split and join
+  return SplitJoin<sjtu::map_policy>() && SplitJoin<order_statistics_policy>() && SplitJoin<threaded_policy>() &&
+         SplitJoin<red_black_policy>() && SplitJoin<rb_all>();
+}
+
+bool check6() { // merge, duplicates stay in the other map
+  return Merge<sjtu::map_policy>() && Merge<order_statistics_policy>() && Merge<threaded_policy>() &&
+         Merge<red_black_policy>() && Merge<rb_all>();
+}
+
+bool check7() { // try_emplace, emplace and insert of an rvalue
+  return Emplace<sjtu::map_policy>() && Emplace<order_statistics_policy>() && Emplace<threaded_policy>() &&
+         Emplace<red_black_policy>() && Emplace<rb_all>();
+}
+
+bool check8() { // hinted insert, assign and the range constructor
+  return HintBuild<sjtu::map_policy>() && HintBuild<order_statistics_policy>() && HintBuild<threaded_policy>() &&
+         HintBuild<red_black_policy>() && HintBuild<rb_all>();
+}
+
+bool check9() { // a three-way compare gives what two less-than calls give
+  return ThreeWay<sjtu::map_policy>() && ThreeWay<order_statistics_policy>() && ThreeWay<threaded_policy>() &&
+         ThreeWay<red_black_policy>() && ThreeWay<rb_all>();
+}
+
+bool check10() { // lookups by another type through a transparent comparator make no Key
+  return Transparent<sjtu::map_policy>() && Transparent<order_statistics_policy>() && Transparent<threaded_policy>() &&
+         Transparent<red_black_policy>() && Transparent<rb_all>();
+}
+
+int main() {
+  if (!check1()) cout << "Test 1 Failed......" << endl; else cout << "Test 1 Passed!" << endl;
+  if (!check2()) cout << "Test 2 Failed......" << endl; else cout << "Test 2 Passed!" << endl;
+  if (!check3()) cout << "Test 3 Failed......" << endl; else cout << "Test 3 Passed!" << endl;
+  if (!check4()) cout << "Test 4 Failed......" << endl; else cout << "Test 4 Passed!" << endl;
+  if (!check5()) cout << "Test 5 Failed......" << endl; else cout << "Test 5 Passed!" << endl;
+  if (!check6()) cout << "Test 6 Failed......" << endl; else cout << "Test 6 Passed!" << endl;
+  if (!check7()) cout << "Test 7 Failed......" << endl; else cout << "Test 7 Passed!" << endl;
+  if (!check8()) cout << "Test 8 Failed......" << endl; else cout << "Test 8 Passed!" << endl;
+  if (!check9()) cout << "Test 9 Failed......" << endl; else cout << "Test 9 Passed!" << endl;
+  if (!check10()) cout << "Test 10 Failed......" << endl; else cout << "Test 10 Passed!" << endl;
+  return 0;
+}
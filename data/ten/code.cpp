@@ -0,0 +1,128 @@
+// key_search.hpp checked against std::lower_bound and std::upper_bound
+// which kernel runs depends on the target: SSE2 by default, SSE4.2 for 64 bit
+// integers and AVX2 with -march=native (cmake -DMAP_BENCH_NATIVE=ON builds
+// key_search_check that way); the keys left over after the last full block
+// go through the scalar loop, so every fill count from 0 up is tried
+// a key type without lanes on this target has no kernel and is skipped
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <cstdio>
+#include "key_search.hpp"
+#include "map.hpp"
+
+using namespace std;
+
+unsigned Last = 20230329;
+
+int Rand() {
+  Last = Last * 1103515245u + 12345u;
+  return int(Last >> 8);
+}
+
+template<class Key>
+using has_lanes = typename std::conditional<std::is_void<typename sjtu::key_lanes<Key>::type>::value,
+                                            sjtu::my_false_type, sjtu::my_true_type>::type;
+
+// both searches give what the standard ones give for every key in probes
+template<class Key>
+bool Agree(const std::vector<Key> &keys, const std::vector<Key> &probes) {
+  int n = keys.size();
+  for (Key key : probes) {
+    int less = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    int not_greater = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+    if (sjtu::key_search<Key>::Less(keys.data(), n, key) != less) return false;
+    if (sjtu::key_search<Key>::NotGreater(keys.data(), n, key) != not_greater) return false;
+  }
+  return true;
+}
+
+// the keys themselves, their neighbours, and the ends of the type
+template<class Key>
+std::vector<Key> Probes(const std::vector<Key> &keys, Key step) {
+  std::vector<Key> probes{std::numeric_limits<Key>::lowest(), std::numeric_limits<Key>::max(), Key(0)};
+  for (Key key : keys) {
+    probes.push_back(key);
+    if (key > std::numeric_limits<Key>::lowest() + step) probes.push_back(Key(key - step));
+    if (key < std::numeric_limits<Key>::max() - step) probes.push_back(Key(key + step));
+  }
+  return probes;
+}
+
+/**
+ * sorted arrays of every length up to a few blocks, from values that are
+ * small, negative, or near the ends of the type, with runs of equal keys
+ * placed across the border of two blocks
+ */
+template<class Key>
+bool Search(Key low, Key high, Key step, sjtu::my_true_type) {
+  const int width = sjtu::key_lanes<Key>::type::width;
+  for (int n = 0; n <= 4 * width + 3; ++n) {
+    for (int round = 0; round < 40; ++round) {
+      std::vector<Key> keys;
+      for (int i = 0; i < n; ++i) {
+        int roll = Rand() % 8;
+        if (roll == 0) {
+          keys.push_back(low);
+        } else if (roll == 1) {
+          keys.push_back(high);
+        } else {
+          // small ones, half of them negative (for signed keys)
+          keys.push_back(Key(Key(Rand() % 64) * step) - Key(32 * step));
+        }
+      }
+      std::sort(keys.begin(), keys.end());
+      // a run of equal keys from just before a block border to just after it
+      if (n > width && round % 2) {
+        int border = width * (1 + Rand() % (n / width)), from = border - 1 - Rand() % 2;
+        int to = std::min(n, border + 1 + Rand() % 2);
+        // the keys after the run are not less than keys[from], so they stay sorted
+        for (int i = from; i < to; ++i) keys[i] = keys[from];
+      }
+      if (!Agree(keys, Probes(keys, step))) return false;
+    }
+    // all equal
+    if (!Agree(std::vector<Key>(n, step), std::vector<Key>{Key(0), step, Key(step + step)})) return false;
+  }
+  return true;
+}
+
+template<class Key>
+bool Search(Key, Key, Key, sjtu::my_false_type) {
+  return true;
+}
+
+template<class Key>
+bool Search(Key low, Key high, Key step) {
+  return Search<Key>(low, high, step, has_lanes<Key>());
+}
+
+bool check1() { // int
+  return Search<int>(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 1) &&
+         Search<int>(-1000000, 1000000, 7);
+}
+
+bool check2() { // unsigned, also above 2^31 where the bias flips the sign
+  return Search<unsigned>(0u, std::numeric_limits<unsigned>::max(), 1u) &&
+         Search<unsigned>(0x7fffff00u, 0x80000100u, 3u);
+}
+
+bool check3() { // long long and unsigned long long
+  return Search<long long>(std::numeric_limits<long long>::min(), std::numeric_limits<long long>::max(), 1) &&
+         Search<long long>(-(1ll << 40), 1ll << 40, 1ll << 20) &&
+         Search<unsigned long long>(0, std::numeric_limits<unsigned long long>::max(), 1);
+}
+
+bool check4() { // double and float, with negatives and halves
+  return Search<double>(-1e300, 1e300, 0.5) && Search<double>(-1.0, 1.0, 1.0 / 64) &&
+         Search<float>(-1e30f, 1e30f, 0.25f);
+}
+
+int main() {
+  if (!check1()) cout << "Test 1 Failed......" << endl; else cout << "Test 1 Passed!" << endl;
+  if (!check2()) cout << "Test 2 Failed......" << endl; else cout << "Test 2 Passed!" << endl;
+  if (!check3()) cout << "Test 3 Failed......" << endl; else cout << "Test 3 Passed!" << endl;
+  if (!check4()) cout << "Test 4 Failed......" << endl; else cout << "Test 4 Passed!" << endl;
+  return 0;
+}
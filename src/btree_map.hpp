@@ -0,0 +1,1013 @@
+/**
+ * a container like std::map, using a B+ tree
+ * same interface and exceptions as sjtu::map in map.hpp, but keys are
+ * packed into node-sized arrays so one cache line holds many separators
+ * and a lookup touches one node per level instead of one per key compared
+ */
+#ifndef SJTU_BTREE_MAP_HPP
+#define SJTU_BTREE_MAP_HPP
+
+// only for std::less<T>
+#include <functional>
+// only for std::allocator<T> and std::allocator_traits<A>
+#include <memory>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+// only for my_true_type, my_false_type, cmp<U, T> and compare_base<C>
+#include "map.hpp"
+#include "key_search.hpp"
+
+/**
+ * layout:
+ *   leaves hold the data in sorted arrays of slots and are chained both ways,
+ *   inner nodes hold sorted separators and their sons; all leaves sit at the
+ *   same depth, and every node but the root stays at least half full
+ *   separator i sends keys less than it to son i and the others to son i + 1,
+ *   it doesn't have to be a key still in the map
+ *
+ * arithmetic keys under std::less<Key> are searched with SIMD compares, see
+ * key_search.hpp; the leaves then also keep a packed copy of their keys, as
+ * the keys inside the slots are too far apart for a vector load
+ * every other key type or comparator goes through calls of the comparator
+ * the map keeps (see compare_base in map.hpp)
+ *
+ * differences from sjtu::map:
+ *   elements move between slots when their neighbours are inserted or erased,
+ *   so insert and erase invalidate every iterator and reference
+ */
+
+namespace sjtu {
+
+// the packed keys of a leaf, nothing at all unless the keys are searched with SIMD
+template<class Enable, class Key, int N>
+struct leaf_keys {};
+
+template<class Key, int N>
+struct leaf_keys<my_true_type, Key, N> {
+  Key keys[N];
+};
+
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<pair<const Key, T>>
+>
+class btree_map : private compare_base<Compare> {
+ public:
+  typedef pair<const Key, T> value_type;
+  typedef Allocator allocator_type;
+  typedef Compare key_compare;
+  // orders values by their keys, what value_comp() hands out
+  class value_compare {
+   protected:
+    Compare comp;
+    explicit value_compare(const Compare &_comp) : comp(_comp) {}
+   public:
+    friend class btree_map;
+    bool operator()(const value_type &one, const value_type &another) const {
+      return comp(one.first, another.first);
+    }
+  };
+ private:
+  // nodes are about node_bytes big, with at least 4 entries
+  static constexpr std::size_t node_bytes = 512;
+  static constexpr int leaf_slots = sizeof(value_type) * 4 > node_bytes ? 4 : int(node_bytes / sizeof(value_type));
+  static constexpr int inner_slots =
+      sizeof(Key) * 8 > node_bytes ? 4 : (node_bytes / 2 / sizeof(Key) > 64 ? 64 : int(node_bytes / 2 / sizeof(Key)));
+  static constexpr int min_leaf = leaf_slots / 2, min_inner = inner_slots / 2;
+  // every inner node has at least 2 sons, so this is far more than enough
+  static constexpr int max_depth = 64;
+  using search_tag = typename std::conditional<
+      !std::is_void<typename key_lanes<Key>::type>::value && cmp<Compare, std::less<Key>>::value,
+      my_true_type, my_false_type>::type;
+
+  struct LeafNode : leaf_keys<search_tag, Key, leaf_slots> {
+    LeafNode *prev, *next;
+    int count;
+    alignas(value_type) unsigned char storage[leaf_slots][sizeof(value_type)];
+    LeafNode() : prev(nullptr), next(nullptr), count(0) {}
+    value_type *Slot(int i) {
+      return reinterpret_cast<value_type *>(storage[i]);
+    }
+    const value_type *Slot(int i) const {
+      return reinterpret_cast<const value_type *>(storage[i]);
+    }
+  };
+
+  struct InnerNode {
+    int count;
+    alignas(Key) unsigned char storage[inner_slots][sizeof(Key)];
+    // InnerNode * or LeafNode *, which one depends on the level
+    void *son[inner_slots + 1];
+    InnerNode() : count(0) {}
+    Key *Separator(int i) {
+      return reinterpret_cast<Key *>(storage[i]);
+    }
+    const Key *Separator(int i) const {
+      return reinterpret_cast<const Key *>(storage[i]);
+    }
+  };
+
+  // the way down to a leaf: the inner node and the son taken on every level
+  struct Path {
+    InnerNode *node[max_depth];
+    int index[max_depth];
+  };
+
+  using leaf_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<LeafNode>;
+  using inner_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<InnerNode>;
+  using leaf_traits = std::allocator_traits<leaf_allocator>;
+  using inner_traits = std::allocator_traits<inner_allocator>;
+
+  int capacity;
+  // number of inner levels, 0 means root is a leaf
+  int levels;
+  void *root;
+  LeafNode *leftmost, *rightmost;
+  leaf_allocator leaf_alloc;
+  inner_allocator inner_alloc;
+
+  inline bool Less(const Key &one, const Key &another) const {
+    return this->KeyComp()(one, another);
+  }
+
+  inline LeafNode *NewLeaf() {
+    LeafNode *now = leaf_traits::allocate(leaf_alloc, 1);
+    return new(now) LeafNode();
+  }
+
+  inline InnerNode *NewInner() {
+    InnerNode *now = inner_traits::allocate(inner_alloc, 1);
+    return new(now) InnerNode();
+  }
+
+  inline void FreeLeaf(LeafNode *now) {
+    for (int i = 0; i < now->count; ++i) now->Slot(i)->~value_type();
+    now->~LeafNode();
+    leaf_traits::deallocate(leaf_alloc, now, 1);
+  }
+
+  inline void FreeInner(InnerNode *now) {
+    for (int i = 0; i < now->count; ++i) now->Separator(i)->~Key();
+    now->~InnerNode();
+    inner_traits::deallocate(inner_alloc, now, 1);
+  }
+
+  /**
+   * the slots only move around inside the tree and the source is destructed
+   * right away, so stealing the key through a const_cast is safe here
+   */
+  inline static void MoveSlot(value_type *to, value_type *from) {
+    new(to) value_type(std::move(const_cast<Key &>(from->first)), std::move(from->second));
+    from->~value_type();
+  }
+
+  inline static void MoveSeparator(Key *to, Key *from) {
+    new(to) Key(std::move(*from));
+    from->~Key();
+  }
+
+  // make the slot pos of leaf free, pos <= count < leaf_slots
+  inline static void OpenSlot(LeafNode *leaf, int pos) {
+    for (int i = leaf->count; i > pos; --i) MoveSlot(leaf->Slot(i), leaf->Slot(i - 1));
+    ++leaf->count;
+  }
+
+  // fill the free slot pos of leaf again
+  inline static void CloseSlot(LeafNode *leaf, int pos) {
+    --leaf->count;
+    for (int i = pos; i < leaf->count; ++i) MoveSlot(leaf->Slot(i), leaf->Slot(i + 1));
+  }
+
+  // copy the keys of the slots from on into the packed keys
+  inline static void SyncKeys(LeafNode *leaf, int from) {
+    SyncKeys(leaf, from, search_tag());
+  }
+
+  inline static void SyncKeys(LeafNode *leaf, int from, my_true_type) {
+    for (int i = from; i < leaf->count; ++i) leaf->keys[i] = leaf->Slot(i)->first;
+  }
+
+  inline static void SyncKeys(LeafNode *, int, my_false_type) {}
+
+  inline int SearchInner(const InnerNode *now, const Key &key) const {
+    return SearchInner(now, key, search_tag());
+  }
+
+  inline int SearchLeaf(const LeafNode *now, const Key &key) const {
+    return SearchLeaf(now, key, search_tag());
+  }
+
+  inline int SearchLeafUpper(const LeafNode *now, const Key &key) const {
+    return SearchLeafUpper(now, key, search_tag());
+  }
+
+  inline int SearchInner(const InnerNode *now, const Key &key, my_true_type) const {
+    return key_search<Key>::NotGreater(now->Separator(0), now->count, key);
+  }
+
+  inline int SearchLeaf(const LeafNode *now, const Key &key, my_true_type) const {
+    return key_search<Key>::Less(now->keys, now->count, key);
+  }
+
+  inline int SearchLeafUpper(const LeafNode *now, const Key &key, my_true_type) const {
+    return key_search<Key>::NotGreater(now->keys, now->count, key);
+  }
+
+  // the son to go down to: the number of separators not greater than key
+  inline int SearchInner(const InnerNode *now, const Key &key, my_false_type) const {
+    int l = 0, r = now->count;
+    while (l < r) {
+      int mid = (l + r) >> 1;
+      if (Less(key, *now->Separator(mid))) {
+        r = mid;
+      } else {
+        l = mid + 1;
+      }
+    }
+    return l;
+  }
+
+  // the first slot whose key is not less than key
+  inline int SearchLeaf(const LeafNode *now, const Key &key, my_false_type) const {
+    int l = 0, r = now->count;
+    while (l < r) {
+      int mid = (l + r) >> 1;
+      if (Less(now->Slot(mid)->first, key)) {
+        l = mid + 1;
+      } else {
+        r = mid;
+      }
+    }
+    return l;
+  }
+
+  // the first slot whose key is greater than key
+  inline int SearchLeafUpper(const LeafNode *now, const Key &key, my_false_type) const {
+    int l = 0, r = now->count;
+    while (l < r) {
+      int mid = (l + r) >> 1;
+      if (Less(key, now->Slot(mid)->first)) {
+        r = mid;
+      } else {
+        l = mid + 1;
+      }
+    }
+    return l;
+  }
+
+  // the leaf where key is or should be, the way down is written to path if asked
+  inline LeafNode *Descend(const Key &key, Path *path) const {
+    void *now = root;
+    for (int depth = 0; depth < levels; ++depth) {
+      InnerNode *inner = static_cast<InnerNode *>(now);
+      int index = SearchInner(inner, key);
+      if (path) path->node[depth] = inner, path->index[depth] = index;
+      now = inner->son[index];
+    }
+    return static_cast<LeafNode *>(now);
+  }
+
+  inline bool FindSlot(const Key &key, LeafNode *&leaf, int &pos) const {
+    if (!root) return false;
+    leaf = Descend(key, nullptr);
+    pos = SearchLeaf(leaf, key);
+    return pos < leaf->count && !Less(key, leaf->Slot(pos)->first);
+  }
+
+  // move an iterator position to the first slot of the next leaf if it fell off its leaf
+  inline static void Normalize(LeafNode *&leaf, int &pos) {
+    if (leaf && pos == leaf->count) leaf = leaf->next, pos = 0;
+  }
+
+  /**
+   * hang son right after the son taken at path->index[depth] of path->node[depth],
+   * with sep between them; a full node is split, which goes on upwards
+   */
+  inline void InsertSon(Path &path, int depth, Key &sep, void *son) {
+    if (depth < 0) {
+      // the root itself was split
+      InnerNode *top = NewInner();
+      new(top->Separator(0)) Key(std::move(sep));
+      top->count = 1;
+      top->son[0] = root, top->son[1] = son;
+      root = top, ++levels;
+      return;
+    }
+    InnerNode *now = path.node[depth];
+    int pos = path.index[depth];
+    if (now->count < inner_slots) {
+      InsertIntoInner(now, pos, sep, son);
+      return;
+    }
+    // split so that both halves end up at least half full
+    const int half = inner_slots / 2;
+    InnerNode *right = NewInner();
+    int from = pos < half ? half - 1 : half;
+    Key up(pos == half ? std::move(sep) : std::move(*now->Separator(from)));
+    int first_key = pos == half ? from : from + 1;
+    for (int i = first_key; i < now->count; ++i) {
+      MoveSeparator(right->Separator(right->count++), now->Separator(i));
+    }
+    if (pos == half) {
+      right->son[0] = son;
+      for (int i = from + 1; i <= now->count; ++i) right->son[i - from] = now->son[i];
+    } else {
+      now->Separator(from)->~Key();
+      for (int i = from + 1; i <= now->count; ++i) right->son[i - from - 1] = now->son[i];
+    }
+    now->count = from;
+    if (pos < half) {
+      InsertIntoInner(now, pos, sep, son);
+    } else if (pos > half) {
+      InsertIntoInner(right, pos - half - 1, sep, son);
+    }
+    InsertSon(path, depth - 1, up, right);
+  }
+
+  inline static void InsertIntoInner(InnerNode *now, int pos, Key &sep, void *son) {
+    for (int i = now->count; i > pos; --i) {
+      MoveSeparator(now->Separator(i), now->Separator(i - 1));
+      now->son[i + 1] = now->son[i];
+    }
+    new(now->Separator(pos)) Key(std::move(sep));
+    now->son[pos + 1] = son;
+    ++now->count;
+  }
+
+  // split a full leaf in two halves, return the right one
+  inline LeafNode *SplitLeaf(LeafNode *leaf, Path &path) {
+    LeafNode *right = NewLeaf();
+    const int half = leaf_slots / 2;
+    for (int i = half; i < leaf->count; ++i) MoveSlot(right->Slot(right->count++), leaf->Slot(i));
+    leaf->count = half;
+    SyncKeys(right, 0);
+    right->next = leaf->next, right->prev = leaf;
+    if (leaf->next) {
+      leaf->next->prev = right;
+    } else {
+      rightmost = right;
+    }
+    leaf->next = right;
+    Key sep(right->Slot(0)->first);
+    InsertSon(path, levels - 1, sep, right);
+    return right;
+  }
+
+  /**
+   * one descent for key: if it is not there, make room on the way back and
+   * build the element in place from args
+   */
+  template<class K, class... Args>
+  inline pair<LeafNode *, int> Emplace(bool &inserted, K &&key, Args &&... args) {
+    inserted = false;
+    if (!root) {
+      leftmost = rightmost = NewLeaf();
+      root = leftmost;
+    }
+    Path path;
+    LeafNode *leaf = Descend(key, &path);
+    int pos = SearchLeaf(leaf, key);
+    if (pos < leaf->count && !Less(key, leaf->Slot(pos)->first)) return pair<LeafNode *, int>(leaf, pos);
+    if (leaf->count == leaf_slots) {
+      LeafNode *right = SplitLeaf(leaf, path);
+      if (pos > leaf->count) leaf = right, pos -= leaf_slots / 2;
+    }
+    OpenSlot(leaf, pos);
+    try {
+      new(leaf->Slot(pos)) value_type(std::piecewise_construct,
+                                      std::forward_as_tuple(std::forward<K>(key)),
+                                      std::forward_as_tuple(std::forward<Args>(args)...));
+    } catch (...) {
+      CloseSlot(leaf, pos);
+      throw;
+    }
+    SyncKeys(leaf, pos);
+    ++capacity, inserted = true;
+    return pair<LeafNode *, int>(leaf, pos);
+  }
+
+  inline void UnlinkLeaf(LeafNode *leaf) {
+    if (leaf->prev) {
+      leaf->prev->next = leaf->next;
+    } else {
+      leftmost = leaf->next;
+    }
+    if (leaf->next) {
+      leaf->next->prev = leaf->prev;
+    } else {
+      rightmost = leaf->prev;
+    }
+  }
+
+  // drop separator pos and the son right of it from now
+  inline static void RemoveFromInner(InnerNode *now, int pos) {
+    now->Separator(pos)->~Key();
+    for (int i = pos + 1; i < now->count; ++i) {
+      MoveSeparator(now->Separator(i - 1), now->Separator(i));
+      now->son[i] = now->son[i + 1];
+    }
+    --now->count;
+  }
+
+  inline static void ResetSeparator(InnerNode *now, int pos, const Key &key) {
+    now->Separator(pos)->~Key();
+    new(now->Separator(pos)) Key(key);
+  }
+
+  /**
+   * leaf fell below half full: borrow from a brother, or merge with one
+   * return where slot pos of leaf is afterwards (pos may be its count)
+   */
+  inline pair<LeafNode *, int> FixLeaf(LeafNode *leaf, Path &path, int pos) {
+    InnerNode *father = path.node[levels - 1];
+    int index = path.index[levels - 1];
+    LeafNode *left = index > 0 ? static_cast<LeafNode *>(father->son[index - 1]) : nullptr;
+    LeafNode *right = index < father->count ? static_cast<LeafNode *>(father->son[index + 1]) : nullptr;
+    if (left && left->count > min_leaf) {
+      OpenSlot(leaf, 0);
+      MoveSlot(leaf->Slot(0), left->Slot(--left->count));
+      SyncKeys(leaf, 0);
+      ResetSeparator(father, index - 1, leaf->Slot(0)->first);
+      return pair<LeafNode *, int>(leaf, pos + 1);
+    }
+    if (right && right->count > min_leaf) {
+      MoveSlot(leaf->Slot(leaf->count++), right->Slot(0));
+      for (int i = 1; i < right->count; ++i) MoveSlot(right->Slot(i - 1), right->Slot(i));
+      --right->count;
+      SyncKeys(leaf, leaf->count - 1), SyncKeys(right, 0);
+      ResetSeparator(father, index, right->Slot(0)->first);
+      return pair<LeafNode *, int>(leaf, pos);
+    }
+    LeafNode *at = leaf;
+    if (left) {
+      int from = left->count;
+      at = left, pos += from;
+      for (int i = 0; i < leaf->count; ++i) MoveSlot(left->Slot(left->count++), leaf->Slot(i));
+      leaf->count = 0;
+      SyncKeys(left, from);
+      UnlinkLeaf(leaf), FreeLeaf(leaf);
+      RemoveFromInner(father, index - 1);
+    } else {
+      int from = leaf->count;
+      for (int i = 0; i < right->count; ++i) MoveSlot(leaf->Slot(leaf->count++), right->Slot(i));
+      right->count = 0;
+      SyncKeys(leaf, from);
+      UnlinkLeaf(right), FreeLeaf(right);
+      RemoveFromInner(father, index);
+    }
+    FixInner(path, levels - 1);
+    return pair<LeafNode *, int>(at, pos);
+  }
+
+  // the inner node on level depth may have fallen below half full
+  inline void FixInner(Path &path, int depth) {
+    InnerNode *now = path.node[depth];
+    if (depth == 0) {
+      if (!now->count) {
+        // the root is left with one son, which becomes the root
+        root = now->son[0];
+        FreeInner(now);
+        --levels;
+      }
+      return;
+    }
+    if (now->count >= min_inner) return;
+    InnerNode *father = path.node[depth - 1];
+    int index = path.index[depth - 1];
+    InnerNode *left = index > 0 ? static_cast<InnerNode *>(father->son[index - 1]) : nullptr;
+    InnerNode *right = index < father->count ? static_cast<InnerNode *>(father->son[index + 1]) : nullptr;
+    if (left && left->count > min_inner) {
+      // spin one separator from left through father
+      for (int i = now->count; i > 0; --i) {
+        MoveSeparator(now->Separator(i), now->Separator(i - 1));
+        now->son[i + 1] = now->son[i];
+      }
+      now->son[1] = now->son[0];
+      MoveSeparator(now->Separator(0), father->Separator(index - 1));
+      now->son[0] = left->son[left->count];
+      MoveSeparator(father->Separator(index - 1), left->Separator(--left->count));
+      ++now->count;
+      return;
+    }
+    if (right && right->count > min_inner) {
+      MoveSeparator(now->Separator(now->count), father->Separator(index));
+      now->son[++now->count] = right->son[0];
+      MoveSeparator(father->Separator(index), right->Separator(0));
+      right->son[0] = right->son[1];
+      for (int i = 1; i < right->count; ++i) {
+        MoveSeparator(right->Separator(i - 1), right->Separator(i));
+        right->son[i] = right->son[i + 1];
+      }
+      --right->count;
+      return;
+    }
+    if (left) {
+      MergeInner(left, now, father, index - 1);
+    } else {
+      MergeInner(now, right, father, index);
+    }
+    FixInner(path, depth - 1);
+  }
+
+  // append right and the separator pos of father to left, then drop right
+  inline void MergeInner(InnerNode *left, InnerNode *right, InnerNode *father, int pos) {
+    MoveSeparator(left->Separator(left->count), father->Separator(pos));
+    left->son[++left->count] = right->son[0];
+    for (int i = 0; i < right->count; ++i) {
+      MoveSeparator(left->Separator(left->count), right->Separator(i));
+      left->son[++left->count] = right->son[i + 1];
+    }
+    right->count = 0;
+    FreeInner(right);
+    // the separator has been moved out already
+    for (int i = pos + 1; i < father->count; ++i) {
+      MoveSeparator(father->Separator(i - 1), father->Separator(i));
+      father->son[i] = father->son[i + 1];
+    }
+    --father->count;
+  }
+
+  /**
+   * destroy slot pos of leaf, return where the element after it is now
+   * path is only read if leaf falls below half full, and then it has to be
+   * the way down to leaf
+   */
+  inline pair<LeafNode *, int> EraseSlot(LeafNode *leaf, int pos, Path &path) {
+    leaf->Slot(pos)->~value_type();
+    CloseSlot(leaf, pos);
+    SyncKeys(leaf, pos);
+    --capacity;
+    if (!levels) {
+      if (!leaf->count) {
+        FreeLeaf(leaf);
+        root = leftmost = rightmost = nullptr;
+        return pair<LeafNode *, int>(nullptr, 0);
+      }
+    } else if (leaf->count < min_leaf) {
+      return FixLeaf(leaf, path, pos);
+    }
+    return pair<LeafNode *, int>(leaf, pos);
+  }
+
+  inline bool Erase(const Key &key) {
+    if (!root) return false;
+    Path path;
+    LeafNode *leaf = Descend(key, &path);
+    int pos = SearchLeaf(leaf, key);
+    if (pos == leaf->count || Less(key, leaf->Slot(pos)->first)) return false;
+    EraseSlot(leaf, pos, path);
+    return true;
+  }
+
+  inline void DeleteTree(void *now, int depth) {
+    if (depth == levels) {
+      FreeLeaf(static_cast<LeafNode *>(now));
+      return;
+    }
+    InnerNode *inner = static_cast<InnerNode *>(now);
+    for (int i = 0; i <= inner->count; ++i) DeleteTree(inner->son[i], depth + 1);
+    FreeInner(inner);
+  }
+
+  // copy the subtree another into a fresh one, chaining the new leaves after tail
+  inline void *CopyTree(const void *another, int depth, LeafNode *&tail) {
+    if (depth == levels) {
+      const LeafNode *from = static_cast<const LeafNode *>(another);
+      LeafNode *now = NewLeaf();
+      now->prev = tail;
+      if (tail) {
+        tail->next = now;
+      } else {
+        leftmost = now;
+      }
+      tail = rightmost = now;
+      for (; now->count < from->count; ++now->count) new(now->Slot(now->count)) value_type(*from->Slot(now->count));
+      SyncKeys(now, 0);
+      return now;
+    }
+    const InnerNode *from = static_cast<const InnerNode *>(another);
+    InnerNode *now = NewInner();
+    int built = 0;
+    try {
+      for (; built <= from->count; ++built) {
+        now->son[built] = CopyTree(from->son[built], depth + 1, tail);
+        if (built < from->count) {
+          try {
+            new(now->Separator(built)) Key(*from->Separator(built));
+          } catch (...) {
+            ++built;
+            throw;
+          }
+          ++now->count;
+        }
+      }
+    } catch (...) {
+      // the leaves copied so far are freed through their chain by CopyFrom
+      for (int i = 0; i < built && depth + 1 < levels; ++i) DropInner(now->son[i], depth + 1);
+      FreeInner(now);
+      throw;
+    }
+    return now;
+  }
+
+  // free the inner nodes of a partial copy, leaving its leaves alone
+  inline void DropInner(void *now, int depth) {
+    InnerNode *inner = static_cast<InnerNode *>(now);
+    for (int i = 0; i <= inner->count && depth + 1 < levels; ++i) DropInner(inner->son[i], depth + 1);
+    FreeInner(inner);
+  }
+
+  inline void CopyFrom(const btree_map &other) {
+    if (!other.root) return;
+    LeafNode *tail = nullptr;
+    levels = other.levels;
+    try {
+      root = CopyTree(other.root, 0, tail);
+    } catch (...) {
+      // the inner nodes are gone, free the leaves through their chain
+      for (LeafNode *now = leftmost; now;) {
+        LeafNode *to_free = now;
+        now = now->next;
+        FreeLeaf(to_free);
+      }
+      root = leftmost = rightmost = nullptr, levels = 0;
+      throw;
+    }
+    capacity = other.capacity;
+  }
+
+ public:
+  class const_iterator;
+  class iterator {
+   private:
+    LeafNode *leaf;
+    int pos;
+    const btree_map *from;
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = btree_map::value_type;
+    using pointer = value_type *;
+    using reference = value_type &;
+    using iterator_category = std::output_iterator_tag;
+    friend class btree_map;
+
+    iterator(LeafNode *_leaf = nullptr, int _pos = 0, const btree_map *_from = nullptr)
+        : leaf(_leaf), pos(_pos), from(_from) {
+      Normalize(leaf, pos);
+    }
+    iterator(const iterator &other) = default;
+    iterator &operator=(const iterator &other) = default;
+
+    iterator operator++(int) {
+      iterator stable_iter = *this;
+      ++*this;
+      return stable_iter;
+    }
+
+    iterator &operator++() {
+      if (!leaf) throw invalid_iterator();
+      ++pos;
+      Normalize(leaf, pos);
+      return *this;
+    }
+
+    iterator operator--(int) {
+      iterator stable_iter = *this;
+      --*this;
+      return stable_iter;
+    }
+
+    iterator &operator--() {
+      if (!from || !from->root || (leaf == from->leftmost && !pos)) throw invalid_iterator();
+      if (!leaf) {
+        leaf = from->rightmost, pos = leaf->count - 1;
+      } else if (pos) {
+        --pos;
+      } else {
+        leaf = leaf->prev, pos = leaf->count - 1;
+      }
+      return *this;
+    }
+
+    value_type &operator*() const {
+      if (!leaf) throw invalid_iterator();
+      return *leaf->Slot(pos);
+    }
+
+    value_type *operator->() const {
+      if (!leaf) throw invalid_iterator();
+      return leaf->Slot(pos);
+    }
+
+    bool operator==(const iterator &rhs) const {
+      return from == rhs.from && leaf == rhs.leaf && pos == rhs.pos;
+    }
+
+    bool operator==(const const_iterator &rhs) const {
+      return from == rhs.from && leaf == rhs.leaf && pos == rhs.pos;
+    }
+
+    bool operator!=(const iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+    bool operator!=(const const_iterator &rhs) const {
+      return !(*this == rhs);
+    }
+  };
+  class const_iterator {
+   private:
+    LeafNode *leaf;
+    int pos;
+    const btree_map *from;
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = btree_map::value_type;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+    using iterator_category = std::output_iterator_tag;
+    friend class btree_map;
+
+    const_iterator(LeafNode *_leaf = nullptr, int _pos = 0, const btree_map *_from = nullptr)
+        : leaf(_leaf), pos(_pos), from(_from) {
+      Normalize(leaf, pos);
+    }
+    const_iterator(const iterator &other) : leaf(other.leaf), pos(other.pos), from(other.from) {}
+    const_iterator(const const_iterator &other) = default;
+    const_iterator &operator=(const const_iterator &other) = default;
+
+    const_iterator operator++(int) {
+      const_iterator stable_iter = *this;
+      ++*this;
+      return stable_iter;
+    }
+
+    const_iterator &operator++() {
+      if (!leaf) throw invalid_iterator();
+      ++pos;
+      Normalize(leaf, pos);
+      return *this;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator stable_iter = *this;
+      --*this;
+      return stable_iter;
+    }
+
+    const_iterator &operator--() {
+      if (!from || !from->root || (leaf == from->leftmost && !pos)) throw invalid_iterator();
+      if (!leaf) {
+        leaf = from->rightmost, pos = leaf->count - 1;
+      } else if (pos) {
+        --pos;
+      } else {
+        leaf = leaf->prev, pos = leaf->count - 1;
+      }
+      return *this;
+    }
+
+    const value_type &operator*() const {
+      if (!leaf) throw invalid_iterator();
+      return *leaf->Slot(pos);
+    }
+
+    const value_type *operator->() const {
+      if (!leaf) throw invalid_iterator();
+      return leaf->Slot(pos);
+    }
+
+    bool operator==(const const_iterator &rhs) const {
+      return from == rhs.from && leaf == rhs.leaf && pos == rhs.pos;
+    }
+
+    bool operator==(const iterator &rhs) const {
+      return from == rhs.from && leaf == rhs.leaf && pos == rhs.pos;
+    }
+
+    bool operator!=(const const_iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+    bool operator!=(const iterator &rhs) const {
+      return !(*this == rhs);
+    }
+  };
+
+  btree_map() : capacity(0), levels(0), root(nullptr), leftmost(nullptr), rightmost(nullptr) {}
+
+  explicit btree_map(const Allocator &alloc)
+      : capacity(0), levels(0), root(nullptr), leftmost(nullptr), rightmost(nullptr),
+        leaf_alloc(alloc), inner_alloc(alloc) {}
+
+  explicit btree_map(const Compare &comp, const Allocator &alloc = Allocator())
+      : compare_base<Compare>(comp), capacity(0), levels(0), root(nullptr), leftmost(nullptr), rightmost(nullptr),
+        leaf_alloc(alloc), inner_alloc(alloc) {}
+
+  btree_map(const btree_map &other)
+      : compare_base<Compare>(other.KeyComp()), capacity(0), levels(0), root(nullptr), leftmost(nullptr), rightmost(nullptr),
+        leaf_alloc(leaf_traits::select_on_container_copy_construction(other.leaf_alloc)),
+        inner_alloc(inner_traits::select_on_container_copy_construction(other.inner_alloc)) {
+    CopyFrom(other);
+  }
+
+  btree_map &operator=(const btree_map &other) {
+    if (this == &other) return *this;
+    clear();
+    this->KeyComp() = other.KeyComp();
+    CopyFrom(other);
+    return *this;
+  }
+
+  ~btree_map() {
+    clear();
+  }
+
+  // a copy of the comparator the keys are ordered by
+  key_compare key_comp() const {
+    return this->KeyComp();
+  }
+
+  value_compare value_comp() const {
+    return value_compare(this->KeyComp());
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(leaf_alloc);
+  }
+
+  T &at(const Key &key) {
+    LeafNode *leaf;
+    int pos;
+    if (!FindSlot(key, leaf, pos)) throw index_out_of_bound();
+    return leaf->Slot(pos)->second;
+  }
+
+  const T &at(const Key &key) const {
+    LeafNode *leaf;
+    int pos;
+    if (!FindSlot(key, leaf, pos)) throw index_out_of_bound();
+    return leaf->Slot(pos)->second;
+  }
+
+  T &operator[](const Key &key) {
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, key);
+    return where.first->Slot(where.second)->second;
+  }
+
+  T &operator[](Key &&key) {
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, std::move(key));
+    return where.first->Slot(where.second)->second;
+  }
+
+  const T &operator[](const Key &key) const {
+    return at(key);
+  }
+
+  iterator begin() {
+    return iterator(leftmost, 0, this);
+  }
+
+  const_iterator cbegin() const {
+    return const_iterator(leftmost, 0, this);
+  }
+
+  iterator end() {
+    return iterator(nullptr, 0, this);
+  }
+
+  const_iterator cend() const {
+    return const_iterator(nullptr, 0, this);
+  }
+
+  bool empty() const {
+    return !capacity;
+  }
+
+  int size() const {
+    return capacity;
+  }
+
+  void clear() {
+    if (root) DeleteTree(root, 0);
+    root = leftmost = rightmost = nullptr;
+    capacity = levels = 0;
+  }
+
+  pair<iterator, bool> insert(const value_type &value) {
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, value.first, value.second);
+    return pair<iterator, bool>(iterator(where.first, where.second, this), inserted);
+  }
+
+  pair<iterator, bool> insert(value_type &&value) {
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, value.first, std::move(value.second));
+    return pair<iterator, bool>(iterator(where.first, where.second, this), inserted);
+  }
+
+  /**
+   * the pair is built first, since its key is only known then, and moved
+   * into its slot; if the key is already there, it is just thrown away
+   */
+  template<class... Args>
+  pair<iterator, bool> emplace(Args &&... args) {
+    value_type value(std::forward<Args>(args)...);
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, std::move(const_cast<Key &>(value.first)), std::move(value.second));
+    return pair<iterator, bool>(iterator(where.first, where.second, this), inserted);
+  }
+
+  /**
+   * like emplace, but nothing is built (and args are left untouched) if key
+   * is already there; otherwise the mapped value is built in place from args
+   */
+  template<class... Args>
+  pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, key, std::forward<Args>(args)...);
+    return pair<iterator, bool>(iterator(where.first, where.second, this), inserted);
+  }
+
+  template<class... Args>
+  pair<iterator, bool> try_emplace(Key &&key, Args &&... args) {
+    bool inserted;
+    pair<LeafNode *, int> where = Emplace(inserted, std::move(key), std::forward<Args>(args)...);
+    return pair<iterator, bool>(iterator(where.first, where.second, this), inserted);
+  }
+
+  /**
+   * erase the element at pos, return an iterator to the one after it
+   * the slot is taken out of the leaf pos already points at; only when that
+   * leaf falls below half full is the way down to it searched for by key,
+   * as borrowing or merging needs its father
+   * throw invalid_iterator if pos is end() or belongs to another map
+   */
+  iterator erase(const_iterator pos) {
+    if (pos.from != this || !pos.leaf) throw invalid_iterator();
+    Path path;
+    if (levels && pos.leaf->count <= min_leaf) Descend(pos.leaf->Slot(pos.pos)->first, &path);
+    pair<LeafNode *, int> after = EraseSlot(pos.leaf, pos.pos, path);
+    return iterator(after.first, after.second, this);
+  }
+
+  iterator erase(iterator pos) {
+    return erase(const_iterator(pos));
+  }
+
+  // the number of elements erased, 0 or 1
+  int erase(const Key &key) {
+    return Erase(key) ? 1 : 0;
+  }
+
+  int count(const Key &key) const {
+    LeafNode *leaf;
+    int pos;
+    return FindSlot(key, leaf, pos) ? 1 : 0;
+  }
+
+  iterator find(const Key &key) {
+    LeafNode *leaf;
+    int pos;
+    return FindSlot(key, leaf, pos) ? iterator(leaf, pos, this) : end();
+  }
+
+  const_iterator find(const Key &key) const {
+    LeafNode *leaf;
+    int pos;
+    return FindSlot(key, leaf, pos) ? const_iterator(leaf, pos, this) : cend();
+  }
+
+  iterator lower_bound(const Key &key) {
+    if (!root) return end();
+    LeafNode *leaf = Descend(key, nullptr);
+    return iterator(leaf, SearchLeaf(leaf, key), this);
+  }
+
+  const_iterator lower_bound(const Key &key) const {
+    if (!root) return cend();
+    LeafNode *leaf = Descend(key, nullptr);
+    return const_iterator(leaf, SearchLeaf(leaf, key), this);
+  }
+
+  iterator upper_bound(const Key &key) {
+    if (!root) return end();
+    LeafNode *leaf = Descend(key, nullptr);
+    return iterator(leaf, SearchLeafUpper(leaf, key), this);
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    if (!root) return cend();
+    LeafNode *leaf = Descend(key, nullptr);
+    return const_iterator(leaf, SearchLeafUpper(leaf, key), this);
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,699 @@
+/**
+ * an AVL map that many threads may read and write at once
+ * keys are spread over N lanes by a Partition, as in sharded_map; each lane is
+ * a chain of immutable versions, like persistent_map: a writer copies the
+ * O(log n) nodes on its way down into a new version of its lane and publishes
+ * it with one store, readers just walk whatever version was current when
+ * they started
+ * readers never wait for a lock, writers only wait for writers of the same lane
+ */
+#ifndef SJTU_CONCURRENT_MAP_HPP
+#define SJTU_CONCURRENT_MAP_HPP
+
+// only for std::less<T>
+#include <functional>
+// only for std::allocator<T> and std::allocator_traits<A>
+#include <memory>
+// only for std::atomic<T>
+#include <atomic>
+// only for std::mutex and std::lock_guard<M>
+#include <mutex>
+// only for std::this_thread::yield
+#include <thread>
+// only for std::index_sequence<I...>
+#include <utility>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+// only for compare_base<C> and node_pool<N, A>
+#include "map.hpp"
+// only for hash_partition<K, N> and range_partition<K, N, C>
+#include "sharded_map.hpp"
+
+/**
+ * readers:
+ *   a read pins the map (see below), loads the current version of the lane
+ *   of its key and walks it; nodes of a published version are never changed,
+ *   so there is nothing to lock and nothing to validate, the walk sees one
+ *   consistent tree
+ *   values are handed out as copies, a reference could outlive the node
+ *
+ * writers:
+ *   a write locks the lane of its key, builds the new version of the lane from
+ *   the current one and publishes it; writes to keys of different lanes run
+ *   in parallel, writes to the same lane take turns, but no write is ever
+ *   thrown away and tried again, and no writer ever blocks a reader
+ *   nodes made by the write in progress carry its stamp; only those are changed
+ *   in place by the spins, any other node is copied first
+ *   next to sharded_map, a write also pays for the path it copies and the
+ *   nodes it retires, while a read takes no lock at all
+ *
+ * lanes:
+ *   hash_partition (the default) and range_partition pick the lane, see
+ *   sharded_map.hpp; each lane is a tree of its own, N times smaller
+ *   size() and for_each see every lane at one version, but not all lanes at
+ *   the same moment: a write landing meanwhile may show up in one lane while
+ *   an earlier one in another lane doesn't
+ *
+ * freeing (epoch based):
+ *   the nodes a write copied are unlinked from the new version, but a reader
+ *   that started on the old one may still be walking them
+ *   a reader pins the map by writing the current epoch into a free slot for as
+ *   long as it reads; a replaced version is tagged with the epoch it was
+ *   replaced in, which is then moved on, and freed with its old nodes once
+ *   no slot holds an epoch that old
+ *   the epoch and the slots are shared by all lanes, the versions waiting to
+ *   be freed are kept by their lane, under its lock
+ *   freed nodes go back to the node_pool of their lane, not to Allocator: a
+ *   lane holds as many slots as it ever had nodes alive and waiting at once,
+ *   and gives them back when the map goes away
+ *
+ * differences from sjtu::map:
+ *   no iterators: for_each visits the values in order instead
+ *   insert and erase tell whether something changed instead of pointing at it
+ *   Allocator is used from many threads at once and has to cope with that
+ */
+
+namespace sjtu {
+
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    int N = 16,
+    class Partition = hash_partition<Key, N>,
+    class Allocator = std::allocator<pair<const Key, T>>
+>
+class concurrent_map : private compare_base<Compare> {
+ public:
+  typedef pair<const Key, T> value_type;
+  typedef Allocator allocator_type;
+  typedef Compare key_compare;
+  static constexpr int lane_count = N;
+  // orders values by their keys, what value_comp() hands out
+  class value_compare {
+   protected:
+    Compare comp;
+    explicit value_compare(const Compare &_comp) : comp(_comp) {}
+   public:
+    friend class concurrent_map;
+    bool operator()(const value_type &one, const value_type &another) const {
+      return comp(one.first, another.first);
+    }
+  };
+ private:
+  // an AVL tree with less than 2^31 nodes is at most 45 high
+  static constexpr int max_height = 48;
+  // readers pinned at the same time; more than that wait for a slot
+  static constexpr int slot_count = 128;
+  // a writer frees what it can once every so many replaced versions
+  static constexpr int sweep_every = 64;
+
+  struct TreeNode {
+    TreeNode *ls, *rs;
+    int height;
+    // the write that made the node, it may change it until it is published
+    unsigned long long stamp;
+    /**
+     * the next node made by the write in progress, or once replaced, the next
+     * node going away with the same version; only the writer of the lane
+     * touches it, readers never look at it, so no list costs an allocation
+     */
+    TreeNode *link;
+    value_type datum;
+    template<class... Args>
+    explicit TreeNode(TreeNode *_ls, TreeNode *_rs, unsigned long long _stamp, Args &&... args)
+        : ls(_ls), rs(_rs), height(1), stamp(_stamp), link(nullptr), datum(std::forward<Args>(args)...) {}
+  };
+
+  struct Version {
+    TreeNode *root;
+    int size;
+    // filled in once it is replaced: the nodes replaced along with it, linked by link
+    TreeNode *dropped;
+    unsigned long long dropped_at;
+    Version *next;
+    Version(TreeNode *_root, int _size) : root(_root), size(_size), dropped(nullptr), dropped_at(0), next(nullptr) {}
+  };
+
+  // own cache line each, pinning is a write
+  struct alignas(64) EpochSlot {
+    std::atomic<unsigned long long> epoch;
+    EpochSlot() : epoch(0) {}
+  };
+
+  using version_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Version>;
+  using version_traits = std::allocator_traits<version_allocator>;
+  using ordered_tag = typename Partition::ordered;
+
+  /**
+   * the keys the Partition sends here, with a chain of versions of their own
+   * everything but current is only touched by the writer holding writer
+   * the nodes come from a pool of the lane's own, so a write mostly reuses
+   * the slots of nodes replaced a few versions ago instead of calling Allocator
+   * own cache line each, padded like the shards of sharded_map
+   */
+  struct alignas(64) Lane {
+    std::atomic<Version *> current;
+    std::mutex writer;
+    // a node of this lane with the stamp of the write in progress was made by it
+    unsigned long long stamps;
+    // replaced versions, oldest first
+    Version *garbage_head, *garbage_tail;
+    int garbage_count;
+    node_pool<TreeNode, Allocator> pool;
+    char padding[64];
+    Lane(const Allocator &alloc)
+        : current(nullptr), stamps(1), garbage_head(nullptr), garbage_tail(nullptr), garbage_count(0), pool(alloc) {}
+  };
+
+  // one write in progress, on lane
+  struct Attempt {
+    Lane &lane;
+    unsigned long long stamp;
+    // both linked by link
+    TreeNode *made, *replaced;
+    bool changed;
+    int added;
+    explicit Attempt(Lane &_lane)
+        : lane(_lane), stamp(_lane.stamps++), made(nullptr), replaced(nullptr), changed(false), added(0) {}
+  };
+
+  // an in-order walk of one version, the way down kept like the iterators of persistent_map do
+  struct Walk {
+    const TreeNode *path[max_height];
+    int depth;
+    Walk() : depth(0) {}
+    inline void PushLeft(const TreeNode *now) {
+      for (; now; now = now->ls) path[depth++] = now;
+    }
+    inline const TreeNode *Top() const {
+      return path[depth - 1];
+    }
+    inline void Next() {
+      PushLeft(path[--depth]->rs);
+    }
+  };
+
+  Lane lanes[N];
+  Partition partition;
+  // 0 in a slot means free, so epochs start at 1
+  std::atomic<unsigned long long> epoch;
+  mutable EpochSlot slots[slot_count];
+  version_allocator version_alloc;
+
+  // keeps the versions seen meanwhile from being freed
+  class Pinned {
+   private:
+    const concurrent_map *from;
+    int slot;
+   public:
+    explicit Pinned(const concurrent_map *_from) : from(_from), slot(_from->Pin()) {}
+    Pinned(const Pinned &) = delete;
+    Pinned &operator=(const Pinned &) = delete;
+    ~Pinned() {
+      from->slots[slot].epoch.store(0, std::memory_order_release);
+    }
+  };
+
+  inline int Pin() const {
+    // threads start looking at different slots
+    static std::atomic<unsigned> next_hint(0);
+    static thread_local unsigned hint = next_hint.fetch_add(1, std::memory_order_relaxed);
+    for (;;) {
+      for (int i = 0; i < slot_count; ++i) {
+        int now = (hint + i) % slot_count;
+        unsigned long long idle = 0;
+        if (slots[now].epoch.load(std::memory_order_relaxed) == 0 &&
+            slots[now].epoch.compare_exchange_strong(idle, epoch.load())) {
+          return now;
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * the oldest epoch a reader is pinned at, or the epoch before the scan
+   * versions retired from here on are tagged with that epoch or a later one,
+   * so a reader pinning behind the scan can never make one look free
+   */
+  inline unsigned long long OldestPinned() const {
+    unsigned long long oldest = epoch.load();
+    for (int i = 0; i < slot_count; ++i) {
+      unsigned long long now = slots[i].epoch.load();
+      if (now && now < oldest) oldest = now;
+    }
+    return oldest;
+  }
+
+  inline bool Less(const Key &one, const Key &another) const {
+    return this->KeyComp()(one, another);
+  }
+
+  template<std::size_t... I>
+  concurrent_map(const Partition &_partition, const Compare &comp, const Allocator &_alloc, std::index_sequence<I...>)
+      : compare_base<Compare>(comp), lanes{{((void) I, _alloc)}...}, partition(_partition), epoch(1),
+        version_alloc(_alloc) {
+    for (Lane &lane : lanes) lane.current.store(NewVersion(nullptr, 0));
+  }
+
+  inline Lane &LaneOf(const Key &key) {
+    return lanes[partition(key)];
+  }
+
+  inline const Lane &LaneOf(const Key &key) const {
+    return lanes[partition(key)];
+  }
+
+  inline static int GetHeight(const TreeNode *obj) {
+    return obj ? obj->height : 0;
+  }
+
+  inline static void Refresh(TreeNode *now) {
+    now->height = std::max(GetHeight(now->ls), GetHeight(now->rs)) + 1;
+  }
+
+  template<class... Args>
+  inline TreeNode *NewNode(Attempt &at, TreeNode *ls, TreeNode *rs, Args &&... args) {
+    TreeNode *now = at.lane.pool.Allocate();
+    try {
+      new(now) TreeNode(ls, rs, at.stamp, std::forward<Args>(args)...);
+    } catch (...) {
+      at.lane.pool.Deallocate(now);
+      throw;
+    }
+    Refresh(now);
+    now->link = at.made, at.made = now;
+    return now;
+  }
+
+  inline static void DeleteNode(Lane &lane, TreeNode *now) {
+    now->~TreeNode();
+    lane.pool.Deallocate(now);
+  }
+
+  // now is copied by this write and goes away with the version it is in
+  inline void Replace(Attempt &at, TreeNode *now) {
+    now->link = at.replaced, at.replaced = now;
+  }
+
+  // a write that threw: nothing it made was ever published
+  inline static void Discard(Attempt &at) {
+    DeleteList(at.lane, at.made);
+    at.made = at.replaced = nullptr;
+  }
+
+  inline static void DeleteList(Lane &lane, TreeNode *now) {
+    while (now) {
+      TreeNode *next = now->link;
+      DeleteNode(lane, now);
+      now = next;
+    }
+  }
+
+  inline Version *NewVersion(TreeNode *root, int size) {
+    Version *now = version_traits::allocate(version_alloc, 1);
+    new(now) Version(root, size);
+    return now;
+  }
+
+  inline void DeleteVersion(Lane &lane, Version *now) {
+    DeleteList(lane, now->dropped);
+    now->~Version();
+    version_traits::deallocate(version_alloc, now, 1);
+  }
+
+  // every node of the subtree, only for trees no one else can see any more
+  static void DeleteTree(Lane &lane, TreeNode *now) {
+    while (now) {
+      DeleteTree(lane, now->ls);
+      TreeNode *next = now->rs;
+      DeleteNode(lane, now);
+      now = next;
+    }
+  }
+
+  // make the node in slot one that only this write sees
+  inline void Unique(Attempt &at, TreeNode *&slot) {
+    if (slot->stamp == at.stamp) return;
+    TreeNode *copy = NewNode(at, slot->ls, slot->rs, slot->datum);
+    Replace(at, slot);
+    slot = copy;
+  }
+
+  // the spins only touch nodes of this write, published sons get copied first
+  inline void LLSpin(Attempt &at, TreeNode *&now) {
+    Unique(at, now->ls);
+    TreeNode *after = now->ls;
+    now->ls = after->rs, after->rs = now;
+    Refresh(now), Refresh(after);
+    now = after;
+  }
+
+  inline void RRSpin(Attempt &at, TreeNode *&now) {
+    Unique(at, now->rs);
+    TreeNode *after = now->rs;
+    now->rs = after->ls, after->ls = now;
+    Refresh(now), Refresh(after);
+    now = after;
+  }
+
+  inline void LRSpin(Attempt &at, TreeNode *&now) {
+    Unique(at, now->ls);
+    RRSpin(at, now->ls);
+    LLSpin(at, now);
+  }
+
+  inline void RLSpin(Attempt &at, TreeNode *&now) {
+    Unique(at, now->rs);
+    LLSpin(at, now->rs);
+    RRSpin(at, now);
+  }
+
+  inline TreeNode *Rebalance(Attempt &at, TreeNode *now) {
+    int diff = GetHeight(now->ls) - GetHeight(now->rs);
+    if (diff > 1) {
+      if (GetHeight(now->ls->ls) >= GetHeight(now->ls->rs)) {
+        LLSpin(at, now);
+      } else {
+        LRSpin(at, now);
+      }
+    } else if (diff < -1) {
+      if (GetHeight(now->rs->rs) >= GetHeight(now->rs->ls)) {
+        RRSpin(at, now);
+      } else {
+        RLSpin(at, now);
+      }
+    } else {
+      Refresh(now);
+    }
+    return now;
+  }
+
+  // the subtree now with value in it, nullptr if nothing had to change
+  TreeNode *Insert(Attempt &at, TreeNode *now, const value_type &value, bool overwrite) {
+    if (!now) {
+      at.changed = true, at.added = 1;
+      return NewNode(at, nullptr, nullptr, value);
+    }
+    if (Less(value.first, now->datum.first)) {
+      TreeNode *left = Insert(at, now->ls, value, overwrite);
+      if (!at.changed) return nullptr;
+      Replace(at, now);
+      return Rebalance(at, NewNode(at, left, now->rs, now->datum));
+    }
+    if (Less(now->datum.first, value.first)) {
+      TreeNode *right = Insert(at, now->rs, value, overwrite);
+      if (!at.changed) return nullptr;
+      Replace(at, now);
+      return Rebalance(at, NewNode(at, now->ls, right, now->datum));
+    }
+    if (!overwrite) return nullptr;
+    at.changed = true;
+    Replace(at, now);
+    return NewNode(at, now->ls, now->rs, value);
+  }
+
+  // the subtree now without its least node, which is handed out in least
+  TreeNode *EraseLeast(Attempt &at, TreeNode *now, const TreeNode *&least) {
+    Replace(at, now);
+    if (!now->ls) {
+      least = now;
+      return now->rs;
+    }
+    TreeNode *left = EraseLeast(at, now->ls, least);
+    return Rebalance(at, NewNode(at, left, now->rs, now->datum));
+  }
+
+  // the subtree now without key, at.changed tells if it was there at all
+  TreeNode *Erase(Attempt &at, TreeNode *now, const Key &key) {
+    if (!now) return nullptr;
+    if (Less(key, now->datum.first)) {
+      TreeNode *left = Erase(at, now->ls, key);
+      if (!at.changed) return nullptr;
+      Replace(at, now);
+      return Rebalance(at, NewNode(at, left, now->rs, now->datum));
+    }
+    if (Less(now->datum.first, key)) {
+      TreeNode *right = Erase(at, now->rs, key);
+      if (!at.changed) return nullptr;
+      Replace(at, now);
+      return Rebalance(at, NewNode(at, now->ls, right, now->datum));
+    }
+    at.changed = true, at.added = -1;
+    Replace(at, now);
+    if (!now->ls) return now->rs;
+    if (!now->rs) return now->ls;
+    // the least node is only replaced, it stays alive while it is copied
+    const TreeNode *least;
+    TreeNode *right = EraseLeast(at, now->rs, least);
+    return Rebalance(at, NewNode(at, now->ls, right, least->datum));
+  }
+
+  // every node of the subtree goes away with the version
+  void ReplaceTree(Attempt &at, TreeNode *now) {
+    while (now) {
+      ReplaceTree(at, now->ls);
+      Replace(at, now);
+      now = now->rs;
+    }
+  }
+
+  /**
+   * build(at, version) makes the new root out of the current version of lane,
+   * and leaves at.changed false if there's nothing to change
+   * only writers holding the lock of the lane replace its version, so the one
+   * built from stays alive without a pin; returns at.changed
+   */
+  template<class Build>
+  bool Update(Lane &lane, Build build) {
+    std::lock_guard<std::mutex> guard(lane.writer);
+    Version *old = lane.current.load(std::memory_order_relaxed);
+    Attempt at(lane);
+    Version *fresh;
+    try {
+      TreeNode *root = build(at, old);
+      if (!at.changed) return false;
+      fresh = NewVersion(root, old->size + at.added);
+    } catch (...) {
+      Discard(at);
+      throw;
+    }
+    lane.current.store(fresh);
+    old->dropped = at.replaced;
+    Retire(lane, old);
+    return true;
+  }
+
+  /**
+   * queues a replaced version of lane; once every sweep_every of them, frees
+   * the ones no reader can still be in, their slots go back to the pool
+   */
+  inline void Retire(Lane &lane, Version *old) {
+    // readers pinning from now on can't reach old
+    old->dropped_at = epoch.fetch_add(1);
+    if (lane.garbage_tail) {
+      lane.garbage_tail->next = old;
+    } else {
+      lane.garbage_head = old;
+    }
+    lane.garbage_tail = old;
+    if (++lane.garbage_count % sweep_every) return;
+    unsigned long long oldest = OldestPinned();
+    while (lane.garbage_head && lane.garbage_head->dropped_at < oldest) {
+      Version *done = lane.garbage_head;
+      lane.garbage_head = done->next;
+      DeleteVersion(lane, done);
+    }
+    if (!lane.garbage_head) lane.garbage_tail = nullptr;
+  }
+
+  // every version of lane, only once no other thread uses the map
+  void DeleteLane(Lane &lane) {
+    Version *last = lane.current.load();
+    DeleteTree(lane, last->root);
+    DeleteVersion(lane, last);
+    while (lane.garbage_head) {
+      Version *next = lane.garbage_head->next;
+      DeleteVersion(lane, lane.garbage_head);
+      lane.garbage_head = next;
+    }
+  }
+
+  // the walks with values left, as a min-heap of their next keys: heap[0] is the least
+  inline void SiftDown(Walk *walks, int *heap, int left, int now) const {
+    for (;;) {
+      int least = now, ls = now * 2 + 1, rs = now * 2 + 2;
+      if (ls < left && Less(walks[heap[ls]].Top()->datum.first, walks[heap[least]].Top()->datum.first)) least = ls;
+      if (rs < left && Less(walks[heap[rs]].Top()->datum.first, walks[heap[least]].Top()->datum.first)) least = rs;
+      if (least == now) return;
+      std::swap(heap[now], heap[least]);
+      now = least;
+    }
+  }
+
+  // a range partition has the lanes in order already
+  template<class Visit>
+  void ForEach(Walk *walks, Visit &visit, my_true_type) const {
+    for (int i = 0; i < N; ++i) {
+      for (; walks[i].depth; walks[i].Next()) visit(walks[i].Top()->datum);
+    }
+  }
+
+  // a hash partition mixes them, so they are merged, O(log N) compares a value
+  template<class Visit>
+  void ForEach(Walk *walks, Visit &visit, my_false_type) const {
+    int heap[N], left = 0;
+    for (int i = 0; i < N; ++i) {
+      if (walks[i].depth) heap[left++] = i;
+    }
+    for (int i = left / 2 - 1; i >= 0; --i) SiftDown(walks, heap, left, i);
+    while (left) {
+      Walk &least = walks[heap[0]];
+      visit(least.Top()->datum);
+      least.Next();
+      if (!least.depth) heap[0] = heap[--left];
+      SiftDown(walks, heap, left, 0);
+    }
+  }
+
+  inline const TreeNode *FindValue(const TreeNode *now, const Key &key) const {
+    while (now) {
+      if (Less(key, now->datum.first)) {
+        now = now->ls;
+      } else if (Less(now->datum.first, key)) {
+        now = now->rs;
+      } else {
+        return now;
+      }
+    }
+    return nullptr;
+  }
+
+ public:
+  concurrent_map() : concurrent_map(Partition()) {}
+
+  explicit concurrent_map(const Allocator &_alloc) : concurrent_map(Partition(), Compare(), _alloc) {}
+
+  explicit concurrent_map(const Compare &comp, const Allocator &_alloc = Allocator())
+      : concurrent_map(Partition(), comp, _alloc) {}
+
+  // every lane orders its keys by comp
+  explicit concurrent_map(const Partition &_partition, const Compare &comp = Compare(),
+                          const Allocator &_alloc = Allocator())
+      : concurrent_map(_partition, comp, _alloc, std::make_index_sequence<N>()) {}
+
+  // the map is shared by address, copying or moving it isn't safe while it is used
+  concurrent_map(const concurrent_map &) = delete;
+  concurrent_map &operator=(const concurrent_map &) = delete;
+
+  // no other thread may use the map any more
+  ~concurrent_map() {
+    for (Lane &lane : lanes) DeleteLane(lane);
+  }
+
+  // a copy of the comparator the keys are ordered by
+  key_compare key_comp() const {
+    return this->KeyComp();
+  }
+
+  value_compare value_comp() const {
+    return value_compare(this->KeyComp());
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(version_alloc);
+  }
+
+  /**
+   * a copy of the value of key
+   * throw index_out_of_bound if key isn't there
+   */
+  T at(const Key &key) const {
+    Pinned pin(this);
+    const TreeNode *now = FindValue(LaneOf(key).current.load()->root, key);
+    if (!now) throw index_out_of_bound();
+    return now->datum.second;
+  }
+
+  // copies the value of key into obj, false (and obj untouched) if key isn't there
+  bool find(const Key &key, T &obj) const {
+    Pinned pin(this);
+    const TreeNode *now = FindValue(LaneOf(key).current.load()->root, key);
+    if (!now) return false;
+    obj = now->datum.second;
+    return true;
+  }
+
+  int count(const Key &key) const {
+    Pinned pin(this);
+    return FindValue(LaneOf(key).current.load()->root, key) ? 1 : 0;
+  }
+
+  bool empty() const {
+    return !size();
+  }
+
+  // the sizes of the lanes, each at one version (see lanes above)
+  int size() const {
+    Pinned pin(this);
+    int total = 0;
+    for (const Lane &lane : lanes) total += lane.current.load()->size;
+    return total;
+  }
+
+  /**
+   * calls visit(value) for every value in key order, one version of each lane
+   * (see lanes above); writes to a lane after its version was loaded aren't
+   * seen, and every version stays pinned until the end, so keep visit short
+   */
+  template<class Visit>
+  void for_each(Visit visit) const {
+    Pinned pin(this);
+    Walk walks[N];
+    for (int i = 0; i < N; ++i) walks[i].PushLeft(lanes[i].current.load()->root);
+    ForEach(walks, visit, ordered_tag());
+  }
+
+  // true if value was put in, false if its key was already there
+  bool insert(const value_type &value) {
+    return Update(LaneOf(value.first), [&](Attempt &at, Version *old) {
+      return Insert(at, old->root, value, false);
+    });
+  }
+
+  // maps key to obj, true if key wasn't there before
+  bool insert_or_assign(const Key &key, const T &obj) {
+    value_type value(key, obj);
+    bool added = false;
+    Update(LaneOf(key), [&](Attempt &at, Version *old) {
+      TreeNode *root = Insert(at, old->root, value, true);
+      added = at.added;
+      return root;
+    });
+    return added;
+  }
+
+  // the number of elements erased, 0 or 1
+  int erase(const Key &key) {
+    return Update(LaneOf(key), [&](Attempt &at, Version *old) {
+      return Erase(at, old->root, key);
+    }) ? 1 : 0;
+  }
+
+  // empties one lane after another, writes meanwhile may land in lanes already emptied
+  void clear() {
+    for (Lane &lane : lanes) {
+      Update(lane, [&](Attempt &at, Version *old) {
+        at.changed = old->root, at.added = -old->size;
+        ReplaceTree(at, old->root);
+        return static_cast<TreeNode *>(nullptr);
+      });
+    }
+  }
+};
+
+}
+
+#endif
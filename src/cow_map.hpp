@@ -0,0 +1,326 @@
+/**
+ * a copy-on-write front end for the map in map.hpp
+ * copying a cow_map only shares the tree; the first call that may change a
+ * copy (or hand out something to change it through) gives that copy a tree
+ * of its own, so code that copies a map and then only reads it never pays
+ * for the clone
+ */
+#ifndef SJTU_COW_MAP_HPP
+#define SJTU_COW_MAP_HPP
+
+// only for std::atomic<T>
+#include <atomic>
+#include "map.hpp"
+
+/**
+ * which calls clone a shared tree:
+ *   every non-const one, i.e. operator[], at, begin, end, find, lower_bound,
+ *   upper_bound, equal_range, insert, emplace, try_emplace, erase and clear;
+ *   the const ones (and cbegin/cend) only read the shared tree
+ *   call them through a const reference to keep the tree shared
+ *
+ * iterators and references:
+ *   they point into the tree the map had when they were taken
+ *   - while the map isn't copied, the usual sjtu::map rules apply
+ *   - once the map is copied, they point into the tree shared with the copy:
+ *     reading through them is fine, but writing through them would be seen
+ *     by the copy as well, so don't; the next non-const call clones the tree
+ *     for this map and after that they belong to the copy only
+ *   so take iterators and references again after copying a map, rather than
+ *   keeping them from before the copy
+ *   the one exception is the call that clones: erase(pos) given an old pos
+ *   while the tree is still shared looks it up again by its key in the new
+ *   tree; once this map has its own tree, an old pos belongs to the copy and
+ *   erase throws invalid_iterator for it, as for any other map's iterator
+ *   insert(hint, value) never fails on an old hint, it just doesn't use it
+ *
+ * the sharing count is atomic, so copies of one map may be used from
+ * different threads, like copies of a std::shared_ptr; one cow_map object
+ * is no more thread safe than a sjtu::map
+ */
+
+namespace sjtu {
+
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<pair<const Key, T>>,
+    class Policy = map_policy
+>
+class cow_map {
+ public:
+  typedef map<Key, T, Compare, Allocator, Policy> map_type;
+  typedef typename map_type::value_type value_type;
+  typedef Allocator allocator_type;
+  typedef typename map_type::iterator iterator;
+  typedef typename map_type::const_iterator const_iterator;
+ private:
+  struct TreeBody {
+    std::atomic<int> refs;
+    map_type tree;
+    template<class... Args>
+    explicit TreeBody(Args &&... args) : refs(1), tree(std::forward<Args>(args)...) {}
+  };
+  using body_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeBody>;
+  using body_traits = std::allocator_traits<body_allocator>;
+
+  // nullptr for a map that was moved from, which reads as empty
+  TreeBody *body;
+  body_allocator alloc;
+
+  template<class... Args>
+  inline TreeBody *NewBody(Args &&... args) {
+    TreeBody *now = body_traits::allocate(alloc, 1);
+    try {
+      return new(now) TreeBody(std::forward<Args>(args)...);
+    } catch (...) {
+      body_traits::deallocate(alloc, now, 1);
+      throw;
+    }
+  }
+
+  inline void Release() {
+    if (!body || body->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    body->~TreeBody();
+    body_traits::deallocate(alloc, body, 1);
+  }
+
+  inline bool Shared() const {
+    return body && body->refs.load(std::memory_order_acquire) != 1;
+  }
+
+  inline const map_type &Tree() const {
+    static const map_type nothing;
+    return body ? body->tree : nothing;
+  }
+
+  // the tree of this map alone, cloned here if it is shared
+  inline map_type &Own() {
+    if (!body) {
+      body = NewBody(Allocator(alloc));
+    } else if (Shared()) {
+      TreeBody *copy = NewBody(body->tree);
+      Release();
+      body = copy;
+    }
+    return body->tree;
+  }
+
+ public:
+  cow_map() : body(nullptr) {
+    body = NewBody();
+  }
+
+  explicit cow_map(const Allocator &_alloc) : body(nullptr), alloc(_alloc) {
+    body = NewBody(_alloc);
+  }
+
+  template<class InputIterator>
+  cow_map(InputIterator first, InputIterator last) : body(nullptr) {
+    body = NewBody(first, last);
+  }
+
+  // shares the tree, O(1)
+  cow_map(const cow_map &other) : body(other.body), alloc(other.alloc) {
+    if (body) body->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  cow_map(cow_map &&other) noexcept : body(other.body), alloc(other.alloc) {
+    other.body = nullptr;
+  }
+
+  // the allocator comes along with the body, whatever frees a body has to be able to
+  cow_map &operator=(const cow_map &other) {
+    if (body == other.body) return *this;
+    if (other.body) other.body->refs.fetch_add(1, std::memory_order_relaxed);
+    Release();
+    body = other.body, alloc = other.alloc;
+    return *this;
+  }
+
+  cow_map &operator=(cow_map &&other) noexcept {
+    if (this == &other) return *this;
+    Release();
+    body = other.body, other.body = nullptr;
+    alloc = other.alloc;
+    return *this;
+  }
+
+  ~cow_map() {
+    Release();
+  }
+
+  void swap(cow_map &other) noexcept {
+    std::swap(body, other.body);
+    std::swap(alloc, other.alloc);
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(alloc);
+  }
+
+  // whether the tree is shared with a copy right now
+  bool is_shared() const {
+    return Shared();
+  }
+
+  T &at(const Key &key) {
+    return Own().at(key);
+  }
+
+  const T &at(const Key &key) const {
+    return Tree().at(key);
+  }
+
+  T &operator[](const Key &key) {
+    return Own()[key];
+  }
+
+  T &operator[](Key &&key) {
+    return Own()[std::move(key)];
+  }
+
+  const T &operator[](const Key &key) const {
+    return Tree()[key];
+  }
+
+  iterator begin() {
+    return Own().begin();
+  }
+
+  const_iterator cbegin() const {
+    return Tree().cbegin();
+  }
+
+  iterator end() {
+    return Own().end();
+  }
+
+  const_iterator cend() const {
+    return Tree().cend();
+  }
+
+  bool empty() const {
+    return Tree().empty();
+  }
+
+  int size() const {
+    return Tree().size();
+  }
+
+  void clear() {
+    if (Shared()) {
+      // nothing to clone, just stop sharing
+      TreeBody *fresh = NewBody(Allocator(alloc));
+      Release();
+      body = fresh;
+      return;
+    }
+    Own().clear();
+  }
+
+  pair<iterator, bool> insert(const value_type &value) {
+    return Own().insert(value);
+  }
+
+  pair<iterator, bool> insert(value_type &&value) {
+    return Own().insert(std::move(value));
+  }
+
+  template<class... Args>
+  pair<iterator, bool> emplace(Args &&... args) {
+    return Own().emplace(std::forward<Args>(args)...);
+  }
+
+  template<class... Args>
+  pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+    return Own().try_emplace(key, std::forward<Args>(args)...);
+  }
+
+  template<class... Args>
+  pair<iterator, bool> try_emplace(Key &&key, Args &&... args) {
+    return Own().try_emplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  // a hint from before the clone belongs to the other tree and is just dropped
+  iterator insert(const_iterator hint, const value_type &value) {
+    if (Shared()) return Own().insert(value).first;
+    return Own().insert(hint, value);
+  }
+
+  iterator insert(const_iterator hint, value_type &&value) {
+    if (Shared()) return Own().insert(std::move(value)).first;
+    return Own().insert(hint, std::move(value));
+  }
+
+  /**
+   * erase the element at pos, return an iterator to the one after it
+   * throw invalid_iterator if pos is end() or belongs to another map
+   * a pos from before the copy is looked up again by its key, but only while
+   * the tree is still shared, i.e. when this call is the one that clones
+   */
+  iterator erase(iterator pos) {
+    if (Shared()) {
+      // checked on the shared tree before anything is cloned: *pos throws for
+      // the end() of any map, and a pos of another map isn't where its key is here
+      const map_type &shared = body->tree;
+      if (pos == shared.cend()) throw invalid_iterator();
+      Key key((*pos).first);
+      if (shared.find(key) != pos) throw invalid_iterator();
+      map_type &tree = Own();
+      return tree.erase(tree.find(key));
+    }
+    return Own().erase(pos);
+  }
+
+  // the number of elements erased, 0 or 1
+  int erase(const Key &key) {
+    return Own().erase(key);
+  }
+
+  int count(const Key &key) const {
+    return Tree().count(key);
+  }
+
+  iterator find(const Key &key) {
+    return Own().find(key);
+  }
+
+  const_iterator find(const Key &key) const {
+    return Tree().find(key);
+  }
+
+  iterator lower_bound(const Key &key) {
+    return Own().lower_bound(key);
+  }
+
+  const_iterator lower_bound(const Key &key) const {
+    return Tree().lower_bound(key);
+  }
+
+  iterator upper_bound(const Key &key) {
+    return Own().upper_bound(key);
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    return Tree().upper_bound(key);
+  }
+
+  pair<iterator, iterator> equal_range(const Key &key) {
+    return Own().equal_range(key);
+  }
+
+  pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+    return Tree().equal_range(key);
+  }
+};
+
+template<class Key, class T, class Compare, class Allocator, class Policy>
+void swap(cow_map<Key, T, Compare, Allocator, Policy> &one, cow_map<Key, T, Compare, Allocator, Policy> &another) noexcept {
+  one.swap(another);
+}
+
+}
+
+#endif
@@ -0,0 +1,241 @@
+/**
+ * searching short sorted arrays of arithmetic keys with SIMD compares
+ * a block of keys is compared against the key in one go and the comparison
+ * mask tells how many of them are in front of it; since the array is sorted
+ * the first block that isn't all in front ends the scan
+ * AVX2 is used when the compiler targets it, then SSE2 (SSE4.2 for 64 bit
+ * integers), and the leftover keys or the types without lanes are scanned one by one
+ */
+#ifndef SJTU_KEY_SEARCH_HPP
+#define SJTU_KEY_SEARCH_HPP
+
+#include <cstdint>
+#include <type_traits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sjtu {
+
+/**
+ * lanes: the vector ops for one kind of key
+ *   Less(v, t) / NotGreater(v, t): bit i of the mask is set if lane i of v is < / <= lane i of t
+ * unsigned integers are flipped to signed ones by the bias, as SSE only compares signed ones
+ */
+#if defined(__AVX2__)
+template<std::uint32_t Bias>
+struct lanes_int32 {
+  using vec = __m256i;
+  static constexpr int width = 8, full = 0xff;
+  static vec Splat(std::int32_t key) {
+    return _mm256_set1_epi32(std::int32_t(std::uint32_t(key) ^ Bias));
+  }
+  static vec Load(const void *keys) {
+    vec v = _mm256_loadu_si256(static_cast<const vec *>(keys));
+    return Bias ? _mm256_xor_si256(v, _mm256_set1_epi32(std::int32_t(Bias))) : v;
+  }
+  static int Less(vec v, vec t) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t, v)));
+  }
+  static int NotGreater(vec v, vec t) {
+    return full & ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, t)));
+  }
+};
+
+template<std::uint64_t Bias>
+struct lanes_int64 {
+  using vec = __m256i;
+  static constexpr int width = 4, full = 0xf;
+  static vec Splat(std::int64_t key) {
+    return _mm256_set1_epi64x(std::int64_t(std::uint64_t(key) ^ Bias));
+  }
+  static vec Load(const void *keys) {
+    vec v = _mm256_loadu_si256(static_cast<const vec *>(keys));
+    return Bias ? _mm256_xor_si256(v, _mm256_set1_epi64x(std::int64_t(Bias))) : v;
+  }
+  static int Less(vec v, vec t) {
+    return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(t, v)));
+  }
+  static int NotGreater(vec v, vec t) {
+    return full & ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, t)));
+  }
+};
+
+struct lanes_float {
+  using vec = __m256;
+  static constexpr int width = 8, full = 0xff;
+  static vec Splat(float key) {
+    return _mm256_set1_ps(key);
+  }
+  static vec Load(const void *keys) {
+    return _mm256_loadu_ps(static_cast<const float *>(keys));
+  }
+  static int Less(vec v, vec t) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_LT_OQ));
+  }
+  static int NotGreater(vec v, vec t) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_LE_OQ));
+  }
+};
+
+struct lanes_double {
+  using vec = __m256d;
+  static constexpr int width = 4, full = 0xf;
+  static vec Splat(double key) {
+    return _mm256_set1_pd(key);
+  }
+  static vec Load(const void *keys) {
+    return _mm256_loadu_pd(static_cast<const double *>(keys));
+  }
+  static int Less(vec v, vec t) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(v, t, _CMP_LT_OQ));
+  }
+  static int NotGreater(vec v, vec t) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(v, t, _CMP_LE_OQ));
+  }
+};
+#elif defined(__SSE2__)
+template<std::uint32_t Bias>
+struct lanes_int32 {
+  using vec = __m128i;
+  static constexpr int width = 4, full = 0xf;
+  static vec Splat(std::int32_t key) {
+    return _mm_set1_epi32(std::int32_t(std::uint32_t(key) ^ Bias));
+  }
+  static vec Load(const void *keys) {
+    vec v = _mm_loadu_si128(static_cast<const vec *>(keys));
+    return Bias ? _mm_xor_si128(v, _mm_set1_epi32(std::int32_t(Bias))) : v;
+  }
+  static int Less(vec v, vec t) {
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, t)));
+  }
+  static int NotGreater(vec v, vec t) {
+    return full & ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, t)));
+  }
+};
+
+#if defined(__SSE4_2__)
+template<std::uint64_t Bias>
+struct lanes_int64 {
+  using vec = __m128i;
+  static constexpr int width = 2, full = 0x3;
+  static vec Splat(std::int64_t key) {
+    return _mm_set1_epi64x(std::int64_t(std::uint64_t(key) ^ Bias));
+  }
+  static vec Load(const void *keys) {
+    vec v = _mm_loadu_si128(static_cast<const vec *>(keys));
+    return Bias ? _mm_xor_si128(v, _mm_set1_epi64x(std::int64_t(Bias))) : v;
+  }
+  static int Less(vec v, vec t) {
+    return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(t, v)));
+  }
+  static int NotGreater(vec v, vec t) {
+    return full & ~_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, t)));
+  }
+};
+#endif
+
+struct lanes_float {
+  using vec = __m128;
+  static constexpr int width = 4, full = 0xf;
+  static vec Splat(float key) {
+    return _mm_set1_ps(key);
+  }
+  static vec Load(const void *keys) {
+    return _mm_loadu_ps(static_cast<const float *>(keys));
+  }
+  static int Less(vec v, vec t) {
+    return _mm_movemask_ps(_mm_cmplt_ps(v, t));
+  }
+  static int NotGreater(vec v, vec t) {
+    return _mm_movemask_ps(_mm_cmple_ps(v, t));
+  }
+};
+
+struct lanes_double {
+  using vec = __m128d;
+  static constexpr int width = 2, full = 0x3;
+  static vec Splat(double key) {
+    return _mm_set1_pd(key);
+  }
+  static vec Load(const void *keys) {
+    return _mm_loadu_pd(static_cast<const double *>(keys));
+  }
+  static int Less(vec v, vec t) {
+    return _mm_movemask_pd(_mm_cmplt_pd(v, t));
+  }
+  static int NotGreater(vec v, vec t) {
+    return _mm_movemask_pd(_mm_cmple_pd(v, t));
+  }
+};
+#endif
+
+// the lanes for Key, void if there are none on this target
+template<class Key, class Enable = void>
+struct key_lanes {
+  using type = void;
+};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+template<class Key>
+struct key_lanes<Key, typename std::enable_if<std::is_integral<Key>::value && sizeof(Key) == 4>::type> {
+  using type = lanes_int32<std::is_signed<Key>::value ? 0u : 0x80000000u>;
+};
+
+template<>
+struct key_lanes<float> {
+  using type = lanes_float;
+};
+
+template<>
+struct key_lanes<double> {
+  using type = lanes_double;
+};
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+template<class Key>
+struct key_lanes<Key, typename std::enable_if<std::is_integral<Key>::value && sizeof(Key) == 8>::type> {
+  using type = lanes_int64<std::is_signed<Key>::value ? 0ull : 0x8000000000000000ull>;
+};
+#endif
+
+/**
+ * Less(keys, n, key): how many of the sorted keys[0, n) are less than key
+ * NotGreater(keys, n, key): how many of them are not greater than key
+ * only meant for a Key whose key_lanes<Key>::type isn't void
+ */
+template<class Key>
+struct key_search {
+  using lanes = typename key_lanes<Key>::type;
+
+  static int Less(const Key *keys, int n, Key key) {
+    int i = 0;
+    auto target = lanes::Splat(key);
+    for (; i + lanes::width <= n; i += lanes::width) {
+      int mask = lanes::Less(lanes::Load(keys + i), target);
+      if (mask != lanes::full) return i + __builtin_popcount(mask);
+    }
+    while (i < n && keys[i] < key) ++i;
+    return i;
+  }
+
+  static int NotGreater(const Key *keys, int n, Key key) {
+    int i = 0;
+    auto target = lanes::Splat(key);
+    for (; i + lanes::width <= n; i += lanes::width) {
+      int mask = lanes::NotGreater(lanes::Load(keys + i), target);
+      if (mask != lanes::full) return i + __builtin_popcount(mask);
+    }
+    while (i < n && !(key < keys[i])) ++i;
+    return i;
+  }
+};
+
+}
+
+#endif
@@ -7,6 +7,16 @@
 
 // only for std::less<T>
 #include <functional>
+// only for std::is_trivially_destructible<T>
+#include <type_traits>
+// only for std::allocator<T> and std::allocator_traits<A>
+#include <memory>
+// only for std::atomic<T>, see node_pool
+#include <atomic>
+// only for std::swap
+#include <utility>
+// only for std::basic_string<C, T, A>, see three_way
+#include <string>
 #include <cstddef>
 #include "utility.hpp"
 #include "exceptions.hpp"
@@ -50,54 +60,481 @@ struct cmp<T, T> {
 };
 //3.分别在可被赋值的迭代器和不可被赋值的迭代器中定义 iterator_assignable 类型
 
+/**
+ * the policy of a map, in the same way as my_type_traits: every optional
+ * feature is switched on by my_true_type and off by my_false_type
+ * derive from map_policy and override the ones you need, e.g.
+ *   struct ranked : map_policy { using order_statistics = my_true_type; };
+ * order_statistics: keep the size of every subtree in the nodes, which makes
+ *   nth(), rank() and iterator jumps O(log n) at the cost of an int per node
+ *   and an O(log n) walk up on every insert/erase; split() needs it to count
+ *   the two parts in O(log n) as well
+ * threaded: thread the nodes on an in-order doubly linked list, which makes
+ *   iterator ++/-- O(1) in the worst case at the cost of two pointers per node
+ * balance: how the tree is kept balanced, avl_tree or red_black_tree
+ *   AVL trees are lower, so lookups are a bit faster; red-black trees spin
+ *   at most twice per insert and three times per erase and stop recolouring
+ *   sooner, so they are the better fit when updates dominate
+ */
+struct avl_tree {};
+struct red_black_tree {};
+
+struct map_policy {
+  using order_statistics = my_false_type;
+  using threaded = my_false_type;
+  using balance = avl_tree;
+};
+
+struct order_statistics_policy : map_policy {
+  using order_statistics = my_true_type;
+};
+
+struct threaded_policy : map_policy {
+  using threaded = my_true_type;
+};
+
+struct red_black_policy : map_policy {
+  using balance = red_black_tree;
+};
+
+// the subtree size kept in a node, nothing at all if it is switched off
+template<class Enable>
+struct node_size {};
+
+template<>
+struct node_size<my_true_type> {
+  int size = 1;
+};
+
+// what the balancing needs in a node: the height of its subtree, or its colour
+template<class Balance>
+struct node_balance;
+
+template<>
+struct node_balance<avl_tree> {
+  int height = 1;
+};
+
+template<>
+struct node_balance<red_black_tree> {
+  bool red = true;
+};
+
+// the in-order neighbours of a node, nothing at all if threading is switched off
+template<class Enable, class Node>
+struct node_thread {};
+
+template<class Node>
+struct node_thread<my_true_type, Node> {
+  Node *prev = nullptr, *next = nullptr;
+};
+
+/**
+ * where a map keeps its comparator: a Compare without state is a base, so it
+ * takes no room at all (empty base optimization); any other one, including
+ * function pointers and final classes, is a plain member
+ */
+template<class Compare, bool Empty = std::is_empty<Compare>::value && !std::is_final<Compare>::value>
+class compare_base : private Compare {
+ protected:
+  compare_base() : Compare() {}
+  explicit compare_base(const Compare &comp) : Compare(comp) {}
+  Compare &KeyComp() {
+    return *this;
+  }
+  const Compare &KeyComp() const {
+    return *this;
+  }
+};
+
+template<class Compare>
+class compare_base<Compare, false> {
+ private:
+  Compare comp;
+ protected:
+  compare_base() : comp() {}
+  explicit compare_base(const Compare &_comp) : comp(_comp) {}
+  Compare &KeyComp() {
+    return comp;
+  }
+  const Compare &KeyComp() const {
+    return comp;
+  }
+};
+
+/**
+ * three-way comparison: with it a descent makes one call per level where a
+ * less-than comparator needs two to tell "left", "right" and "found" apart
+ * three_way<Compare, Key>::tag is my_true_type when there is one, and then
+ * Order(comp, a, b) is < 0, 0 or > 0 as a is before, equal to or after b:
+ *   a Compare with a member int compare(const Key &, const Key &) const has one
+ *   std::less of a std::basic_string has one through basic_string::compare
+ * any other comparator is only called as a less-than
+ */
+template<class... Types>
+struct make_void {
+  using type = void;
+};
+
+template<class Compare, class Key, class Enable = void>
+struct three_way {
+  using tag = my_false_type;
+};
+
+template<class Compare, class Key>
+struct three_way<Compare, Key, typename make_void<decltype(
+    std::declval<const Compare &>().compare(std::declval<const Key &>(), std::declval<const Key &>()))>::type> {
+  using tag = my_true_type;
+  static int Order(const Compare &comp, const Key &one, const Key &another) {
+    return comp.compare(one, another);
+  }
+};
+
+template<class Char, class Traits, class Alloc>
+struct three_way<std::less<std::basic_string<Char, Traits, Alloc>>, std::basic_string<Char, Traits, Alloc>> {
+  using tag = my_true_type;
+  static int Order(const std::less<std::basic_string<Char, Traits, Alloc>> &,
+                   const std::basic_string<Char, Traits, Alloc> &one,
+                   const std::basic_string<Char, Traits, Alloc> &another) {
+    return one.compare(another);
+  }
+};
+
+/**
+ * turns a three-way function object, int Three(a, b) as above, into a
+ * comparator for the map that has both the less-than and the compare()
+ * e.g. map<Bint, int, three_way_less<BintOrder>>
+ */
+template<class Three>
+struct three_way_less : private Three {
+  three_way_less() : Three() {}
+  explicit three_way_less(const Three &three) : Three(three) {}
+  template<class Key>
+  bool operator()(const Key &one, const Key &another) const {
+    return Three::operator()(one, another) < 0;
+  }
+  template<class Key>
+  int compare(const Key &one, const Key &another) const {
+    return Three::operator()(one, another);
+  }
+};
+
+/**
+ * a slab pool for the nodes of one map
+ * nodes are carved out of big slabs by bumping a pointer, erased nodes are
+ * recycled through a free list, and Release() gives back every slab at once
+ * the slabs come from Alloc rebound to Node, so a user allocator sees one
+ * allocate() per slab rather than one per node
+ * slot 0 of each slab is borrowed to chain the slabs together
+ * Recycle() keeps the slabs as spares for the next nodes, and Reserve(n)
+ * gets room for n nodes in one slab, which is what bulk copies use
+ * the pool never constructs or destructs a Node, it only hands out raw slots
+ *
+ * when split, join or merge hand nodes over from one map to another, the slabs
+ * holding them have to outlive both pools: Share(other) turns the slabs of
+ * other into a group, which both pools then link; the group counts the pools
+ * linking it (atomically, the maps may live in different threads) and the
+ * last one to let go of it gives its slabs back
+ * slots a pool frees go to its own free list, wherever their slab is
+ * when other then gives all its nodes away (a join), Adopt(other) takes its
+ * free slots over and turns the groups no other pool links any more back
+ * into own slabs, so splitting and joining again and again leaves neither
+ * groups nor lost free slots behind; groups only pile up while the pools
+ * that took nodes from each other all live on, and Share() is linear in them
+ * a free slot is still only reused by the pool holding it: split hands its
+ * free list to the new map, yet a map that keeps splitting off, changing and
+ * joining back its parts may hold more slots than its peak size
+ */
+template<class Node, class Alloc>
+class node_pool {
+ public:
+  using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+ private:
+  using traits = std::allocator_traits<allocator_type>;
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+  struct SlabHead {
+    SlabHead *next;
+    std::size_t slots;
+  };
+  static_assert(sizeof(FreeSlot) <= sizeof(Node) && sizeof(SlabHead) <= sizeof(Node),
+                "a node slot should be able to hold the bookkeeping of the pool");
+  struct SlabGroup {
+    std::atomic<int> owners;
+    SlabHead *slabs;
+    explicit SlabGroup(SlabHead *_slabs) : owners(0), slabs(_slabs) {}
+  };
+  struct GroupLink {
+    SlabGroup *group;
+    GroupLink *next;
+  };
+  using group_traits = typename traits::template rebind_traits<SlabGroup>;
+  using link_traits = typename traits::template rebind_traits<GroupLink>;
+  static constexpr std::size_t min_slab = 16, max_slab = 4096;
+
+  allocator_type alloc;
+  // spare slabs are owned but not handed out from yet, spare_slots counts their free slots
+  SlabHead *slabs, *spare;
+  FreeSlot *recycled;
+  Node *cursor, *limit;
+  std::size_t slab_size, spare_slots;
+  // the shared slabs this pool keeps alive
+  GroupLink *groups;
+
+  inline static void FreeSlabs(allocator_type &alloc, SlabHead *list) {
+    while (list) {
+      SlabHead *to_free = list;
+      std::size_t slots = to_free->slots;
+      list = list->next;
+      traits::deallocate(alloc, (Node *) to_free, slots);
+    }
+  }
+
+  inline void AddGroup(SlabGroup *group) {
+    for (GroupLink *now = groups; now; now = now->next) {
+      if (now->group == group) return;
+    }
+    typename link_traits::allocator_type link_alloc(alloc);
+    GroupLink *link = link_traits::allocate(link_alloc, 1);
+    groups = new(link) GroupLink{group, groups};
+    group->owners.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  inline void DropGroups() {
+    typename link_traits::allocator_type link_alloc(alloc);
+    typename group_traits::allocator_type group_alloc(alloc);
+    while (groups) {
+      GroupLink *link = groups;
+      groups = groups->next;
+      SlabGroup *group = link->group;
+      link_traits::deallocate(link_alloc, link, 1);
+      if (group->owners.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+      FreeSlabs(alloc, group->slabs);
+      group->~SlabGroup();
+      group_traits::deallocate(group_alloc, group, 1);
+    }
+  }
+
+  // the groups no other pool links any more become own slabs again
+  inline void Unshare() {
+    typename link_traits::allocator_type link_alloc(alloc);
+    typename group_traits::allocator_type group_alloc(alloc);
+    GroupLink **link = &groups;
+    while (*link) {
+      SlabGroup *group = (*link)->group;
+      // only this pool links it, so no other thread can start linking it now
+      if (group->owners.load(std::memory_order_acquire) != 1) {
+        link = &(*link)->next;
+        continue;
+      }
+      SlabHead *last = group->slabs;
+      while (last->next) last = last->next;
+      last->next = slabs, slabs = group->slabs;
+      GroupLink *to_free = *link;
+      *link = to_free->next;
+      link_traits::deallocate(link_alloc, to_free, 1);
+      group->~SlabGroup();
+      group_traits::deallocate(group_alloc, group, 1);
+    }
+  }
+
+  // the own slabs (not the spares, they hold no nodes) become a group linked by this pool
+  inline void Seal() {
+    if (!slabs) return;
+    typename group_traits::allocator_type group_alloc(alloc);
+    SlabGroup *group = new(group_traits::allocate(group_alloc, 1)) SlabGroup(slabs);
+    try {
+      AddGroup(group);
+    } catch (...) {
+      group->~SlabGroup();
+      group_traits::deallocate(group_alloc, group, 1);
+      throw;
+    }
+    slabs = nullptr;
+  }
+
+  inline void NewSlab() {
+    if (spare) {
+      SlabHead *slab = spare;
+      spare = spare->next, spare_slots -= slab->slots - 1;
+      slab->next = slabs, slabs = slab;
+      cursor = (Node *) slab + 1, limit = (Node *) slab + slab->slots;
+      return;
+    }
+    Node *slab = traits::allocate(alloc, slab_size);
+    slabs = new(slab) SlabHead{slabs, slab_size};
+    cursor = slab + 1, limit = slab + slab_size;
+    // small maps stay small, big maps quickly get big slabs
+    if (slab_size < max_slab) slab_size <<= 1;
+  }
+
+ public:
+  explicit node_pool(const Alloc &_alloc = Alloc())
+      : alloc(_alloc), slabs(nullptr), spare(nullptr), recycled(nullptr), cursor(nullptr), limit(nullptr),
+        slab_size(min_slab), spare_slots(0), groups(nullptr) {}
+  node_pool(const node_pool &) = delete;
+  node_pool &operator=(const node_pool &) = delete;
+  // the slabs go along with the allocator, other is left empty
+  node_pool(node_pool &&other) noexcept
+      : alloc(std::move(other.alloc)), slabs(other.slabs), spare(other.spare), recycled(other.recycled),
+        cursor(other.cursor), limit(other.limit), slab_size(other.slab_size), spare_slots(other.spare_slots),
+        groups(other.groups) {
+    other.slabs = other.spare = nullptr;
+    other.recycled = nullptr, other.cursor = other.limit = nullptr;
+    other.slab_size = min_slab, other.spare_slots = 0;
+    other.groups = nullptr;
+  }
+  ~node_pool() {
+    Release();
+  }
+
+  inline const allocator_type &get_allocator() const {
+    return alloc;
+  }
+
+  inline Node *Allocate() {
+    if (recycled) {
+      FreeSlot *slot = recycled;
+      recycled = slot->next;
+      return (Node *) slot;
+    }
+    if (cursor == limit) NewSlab();
+    return cursor++;
+  }
+
+  inline void Deallocate(Node *obj) {
+    recycled = new(obj) FreeSlot{recycled};
+  }
+
+  // every slot handed out is forgotten, the caller should have destructed them
+  inline void Release() {
+    FreeSlabs(alloc, slabs), FreeSlabs(alloc, spare);
+    DropGroups();
+    slabs = spare = nullptr;
+    recycled = nullptr, cursor = limit = nullptr;
+    slab_size = min_slab, spare_slots = 0;
+  }
+
+  // same as Release(), but the own slabs are kept as spares instead of given back
+  inline void Recycle() {
+    while (slabs) {
+      SlabHead *slab = slabs;
+      slabs = slabs->next;
+      slab->next = spare, spare = slab, spare_slots += slab->slots - 1;
+    }
+    DropGroups();
+    recycled = nullptr, cursor = limit = nullptr;
+  }
+
+  /**
+   * keep the slabs of other alive as long as this pool, so that nodes of other
+   * may be handed over to this one; other keeps them alive as well
+   * other has to use the same allocator, as either may give them back
+   */
+  inline void Share(node_pool &other) {
+    other.Seal();
+    for (GroupLink *now = other.groups; now; now = now->next) AddGroup(now->group);
+  }
+
+  /**
+   * after Share(other), once other holds no node any more: its free slots,
+   * also the rest of the slab it was handing out from, go to the free list
+   * here and other is left empty, then see Unshare()
+   * a step per free slot, which the frees and allocations of other have paid
+   */
+  inline void Adopt(node_pool &other) {
+    while (other.cursor != other.limit) Deallocate(other.cursor++);
+    while (other.recycled) {
+      FreeSlot *slot = other.recycled;
+      other.recycled = slot->next;
+      Deallocate((Node *) slot);
+    }
+    other.Release();
+    Unshare();
+  }
+
+  // hand the free list over to a new pool that took nodes from this one
+  inline void GiveFree(node_pool &to) {
+    std::swap(recycled, to.recycled);
+  }
+
+  inline void swap(node_pool &other) noexcept {
+    std::swap(alloc, other.alloc);
+    std::swap(slabs, other.slabs), std::swap(spare, other.spare), std::swap(recycled, other.recycled);
+    std::swap(cursor, other.cursor), std::swap(limit, other.limit);
+    std::swap(slab_size, other.slab_size), std::swap(spare_slots, other.spare_slots);
+    std::swap(groups, other.groups);
+  }
+
+  // make sure the next n nodes need no more than one allocate()
+  inline void Reserve(std::size_t n) {
+    std::size_t room = (limit - cursor) + spare_slots;
+    if (room >= n) return;
+    std::size_t slots = n - room + 1;
+    Node *slab = traits::allocate(alloc, slots);
+    spare = new(slab) SlabHead{spare, slots}, spare_slots += slots - 1;
+  }
+};
+
+/**
+ * Compare is kept in the map (see compare_base), so it may carry state, e.g.
+ * a collation table; a copy of the map copies it along
+ * Allocator is rebound to the node type: every node of the map, and so every
+ * datum, is taken from it slab by slab through node_pool
+ * Policy switches the optional features, see map_policy
+ */
 template<
     class Key,
     class T,
-    class Compare = std::less<Key>
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<pair<const Key, T>>,
+    class Policy = map_policy
 >
-class map {
+class map : private compare_base<Compare> {
  public:
   typedef pair<const Key, T> value_type;
+  typedef Allocator allocator_type;
+  typedef Compare key_compare;
+  // orders values by their keys, what value_comp() hands out
+  class value_compare {
+   protected:
+    Compare comp;
+    explicit value_compare(const Compare &_comp) : comp(_comp) {}
+   public:
+    friend class map;
+    bool operator()(const value_type &one, const value_type &another) const {
+      return comp(one.first, another.first);
+    }
+  };
  private:
-  struct TreeNode {
-    friend class map<Key, T, Compare>;
+  using order_tag = typename Policy::order_statistics;
+  using thread_tag = typename Policy::threaded;
+  using balance_tag = typename Policy::balance;
+  using three_way_tag = typename three_way<Compare, Key>::tag;
+  struct TreeNode : node_size<order_tag>, node_thread<thread_tag, TreeNode>, node_balance<balance_tag> {
+    friend class map;
     TreeNode *ls, *rs, *father;
-    value_type *datum;
-    int height;
+    value_type datum;
     /**
      * stated below are the basic functions of the Node
+     * the datum lives inside the node, so a node is one slot of the pool
+     * and it is always built by placement new on such a slot,
+     * with the datum built in place from args
      */
-    TreeNode(
-        const value_type &_datum = NULL,
-        TreeNode *_ls = nullptr,
-        TreeNode *_rs = nullptr,
-        TreeNode *_father = nullptr,
-        int _height = 0)
-        : ls(_ls), rs(_rs), father(_father), height(_height) {
-      datum = (value_type *) malloc(sizeof(value_type));
-      new(datum) value_type(_datum.first, _datum.second);
-    };
-    /**
-     * please note that we still use malloc-free here as our constructor
-     * because maybe Key doesn't have a default constructor
-     */
-    TreeNode(const TreeNode &obj) : ls(obj.ls), rs(obj.rs), father(obj.father), height(obj.height) {
-      datum = (value_type *) malloc(sizeof(value_type));
-      new(datum) value_type(obj.datum->first, obj.datum->second);
-    }
-    ~TreeNode() {
-      datum->first.~Key(), datum->second.~T();
-      free(datum);
-      datum = nullptr;
-    }
-    friend bool operator<(const TreeNode &one, const TreeNode &another) {
-      return Compare{}(one.datum->first, another.datum->first);
-    }
+    template<class... Args>
+    explicit TreeNode(TreeNode *_father, Args &&... args)
+        : ls(nullptr), rs(nullptr), father(_father), datum(std::forward<Args>(args)...) {}
   };
 
  private:
   int capacity;
   TreeNode *root;
+  // the first and the last node, kept up to date so begin() and --end() are O(1)
+  TreeNode *leftmost, *rightmost;
+  // 72 of the 104 bytes of a map<int, int>: a stateless allocator, five
+  // pointers and two counts of slabs, and the groups split and join share
+  node_pool<TreeNode, Allocator> pool;
   /**
    * listed below are the basic functions of the map
    * the internally-supplementary ones are listed as private
@@ -106,34 +543,167 @@ class map {
     return obj ? obj->height : 0;
   }
 
-  inline void DeleteNode(TreeNode *&now) {
-    if (!now) return;
-    if (now->ls) DeleteNode(now->ls);
-    if (now->rs) DeleteNode(now->rs);
-    delete now, now = nullptr;
+  inline int GetSize(const TreeNode *obj, my_true_type) const {
+    return obj ? obj->size : 0;
   }
 
-  inline TreeNode *FindValue(TreeNode *now, const Key &key) const {
-    if (!now) return nullptr;
-    if (!Compare{}(key, now->datum->first) && !Compare{}(now->datum->first, key)) return now;
-    if (Compare{}(key, now->datum->first)) return FindValue(now->ls, key);
-    else return FindValue(now->rs, key);
+  inline void ResetSize(TreeNode *obj, my_true_type) {
+    obj->size = GetSize(obj->ls, my_true_type()) + GetSize(obj->rs, my_true_type()) + 1;
   }
 
-  inline void CopyNode(TreeNode *&one, const TreeNode *another) {
-    if (!another) {
-      one = nullptr;
-      return;
+  inline void ResetSize(TreeNode *, my_false_type) {}
+
+  inline void ResetHeight(TreeNode *now, avl_tree) {
+    now->height = std::max(GetHeight(now->ls), GetHeight(now->rs)) + 1;
+  }
+
+  // colours don't follow from the sons
+  inline void ResetHeight(TreeNode *, red_black_tree) {}
+
+  // recompute the height (and the size if kept) of now from its sons
+  inline void Refresh(TreeNode *now) {
+    ResetHeight(now, balance_tag());
+    ResetSize(now, order_tag());
+  }
+
+  inline static bool IsRed(const TreeNode *obj) {
+    return obj && obj->red;
+  }
+
+  // sizes change all the way up, even where Retrace is allowed to stop early
+  inline void ResizePath(TreeNode *now, my_true_type) {
+    for (; now; now = now->father) ResetSize(now, my_true_type());
+  }
+
+  inline void ResizePath(TreeNode *, my_false_type) {}
+
+  // take over the bookkeeping of another, used when cloning a node
+  inline void CopyState(TreeNode *one, const TreeNode *another) {
+    static_cast<node_balance<balance_tag> &>(*one) = static_cast<const node_balance<balance_tag> &>(*another);
+    static_cast<node_size<order_tag> &>(*one) = static_cast<const node_size<order_tag> &>(*another);
+  }
+
+  template<class... Args>
+  inline TreeNode *NewNode(TreeNode *its_father, Args &&... args) {
+    TreeNode *slot = pool.Allocate();
+    try {
+      return new(slot) TreeNode(its_father, std::forward<Args>(args)...);
+    } catch (...) {
+      pool.Deallocate(slot);
+      throw;
     }
-    one = new TreeNode(*another);
-    one->father = another->father;
-    if (another->ls) {
-      CopyNode(one->ls, another->ls);
-      one->ls->father = one;
+  }
+
+  inline void FreeNode(TreeNode *now) {
+    now->~TreeNode();
+    pool.Deallocate(now);
+  }
+
+  /**
+   * drop the whole tree: the data are destructed in order (skipped when
+   * value_type is trivially destructible) and then every slab is returned
+   * at once, so no node is freed one by one
+   * with keep_slabs the slabs stay in the pool for the nodes to come
+   */
+  inline void ReleaseTree(bool keep_slabs = false) {
+    if (!std::is_trivially_destructible<value_type>::value && root) {
+      // the tree may be half-built here, so leftmost can't be trusted
+      TreeNode *now = root;
+      while (now->ls) now = now->ls;
+      while (now) {
+        TreeNode *to_destroy = now;
+        Next(now, my_false_type());
+        to_destroy->~TreeNode();
+      }
     }
-    if (another->rs) {
-      CopyNode(one->rs, another->rs);
-      one->rs->father = one;
+    if (keep_slabs) {
+      pool.Recycle();
+    } else {
+      pool.Release();
+    }
+    root = leftmost = rightmost = nullptr;
+  }
+
+  // one or the other may be some other type than Key with a transparent Compare
+  template<class One, class Another>
+  inline bool Less(const One &one, const Another &another) const {
+    return this->KeyComp()(one, another);
+  }
+
+  // only with a three-way Compare, see three_way
+  inline int Order(const Key &one, const Key &another) const {
+    return three_way<Compare, Key>::Order(this->KeyComp(), one, another);
+  }
+
+  // the three-way comparison is only there for two Keys
+  template<class K>
+  using three_way_for = typename std::conditional<std::is_same<K, Key>::value, three_way_tag, my_false_type>::type;
+
+  template<class K>
+  inline TreeNode *FindValue(TreeNode *now, const K &key) const {
+    return FindValue(now, key, three_way_for<K>());
+  }
+
+  template<class K>
+  inline TreeNode *FindValue(TreeNode *now, const K &key, my_false_type) const {
+    while (now) {
+      if (Less(key, now->datum.first)) {
+        now = now->ls;
+      } else if (Less(now->datum.first, key)) {
+        now = now->rs;
+      } else {
+        return now;
+      }
+    }
+    return nullptr;
+  }
+
+  inline TreeNode *FindValue(TreeNode *now, const Key &key, my_true_type) const {
+    while (now) {
+      int order = Order(key, now->datum.first);
+      if (order < 0) {
+        now = now->ls;
+      } else if (order > 0) {
+        now = now->rs;
+      } else {
+        return now;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * the slot holding now: root, or the ls/rs field of its father
+   * spinning on it re-links the subtree into the tree automatically
+   */
+  inline TreeNode *&Link(TreeNode *now) {
+    if (!now->father) return root;
+    return now->father->ls == now ? now->father->ls : now->father->rs;
+  }
+
+  /**
+   * copy the tree of another into one by walking both trees in lockstep
+   * one is set before the walk, so a half-built tree can still be released
+   * if a copy of the datum throws
+   */
+  inline void CopyNode(TreeNode *&one, const TreeNode *another) {
+    one = nullptr;
+    if (!another) return;
+    TreeNode *top = one = NewNode(nullptr, another->datum), *now = one;
+    CopyState(now, another);
+    while (true) {
+      if (another->ls && !now->ls) {
+        another = another->ls;
+        now->ls = NewNode(now, another->datum), now = now->ls;
+        CopyState(now, another);
+      } else if (another->rs && !now->rs) {
+        another = another->rs;
+        now->rs = NewNode(now, another->datum), now = now->rs;
+        CopyState(now, another);
+      } else {
+        if (now == top) break;
+        now = now->father, another = another->father;
+      }
     }
   }
 
@@ -146,8 +716,7 @@ class map {
     after->rs = now;
     after->father = now->father, now->father = after;
     // bottom-up updating
-    now->height = std::max(GetHeight(now->ls), GetHeight(now->rs)) + 1;
-    after->height = std::max(GetHeight(after->ls), GetHeight(after->rs)) + 1;
+    Refresh(now), Refresh(after);
     now = after;
   }
 
@@ -160,8 +729,7 @@ class map {
     after->ls = now;
     after->father = now->father, now->father = after;
     // bottom-up updating
-    now->height = std::max(GetHeight(now->ls), GetHeight(now->rs)) + 1;
-    after->height = std::max(GetHeight(after->ls), GetHeight(after->rs)) + 1;
+    Refresh(now), Refresh(after);
     now = after;
   }
 
@@ -175,177 +743,658 @@ class map {
     RRSpin(now);
   }
 
-  inline void maintain(TreeNode *&now, const value_type &x) {
-    if (GetHeight(now->ls) - GetHeight(now->rs) < 2 && GetHeight(now->ls) - GetHeight(now->rs) > -2) return;
-    if (GetHeight(now->ls) - GetHeight(now->rs) > 1) {
-      if (Compare{}(x.first, now->ls->datum->first)) {
+  /**
+   * rebalance now, whose subtrees are AVL trees differing in height by at most 2,
+   * and refresh its height
+   * ties go to the single spin, which is what erasing needs (case e)
+   */
+  inline void Rebalance(TreeNode *&now) {
+    int diff = GetHeight(now->ls) - GetHeight(now->rs);
+    if (diff > 1) {
+      if (GetHeight(now->ls->ls) >= GetHeight(now->ls->rs)) {
         LLSpin(now);
       } else {
         LRSpin(now);
       }
-    } else {
-      if (Compare{}(x.first, now->rs->datum->first)) {
-        RLSpin(now);
-      } else {
+    } else if (diff < -1) {
+      if (GetHeight(now->rs->rs) >= GetHeight(now->rs->ls)) {
         RRSpin(now);
+      } else {
+        RLSpin(now);
       }
+    } else {
+      Refresh(now);
     }
   }
 
-  inline TreeNode *NodeInsert(TreeNode *&now, const value_type &x, TreeNode *its_father) {
-    TreeNode *return_node;
-    if (!now) {
-      now = new TreeNode(x, nullptr, nullptr, its_father, 1);
-      return now;
-    } else {
-      if (Compare{}(x.first, now->datum->first)) {
-        return_node = NodeInsert(now->ls, x, now);
-        maintain(now, x);
+  /**
+   * walk up through the father pointers after a subtree below now changed
+   * once a subtree keeps its old height nothing above it can change, so we stop
+   */
+  inline void Retrace(TreeNode *now) {
+    while (now) {
+      int old_height = now->height;
+      TreeNode *&slot = Link(now);
+      Rebalance(slot);
+      if (slot->height == old_height) return;
+      now = slot->father;
+    }
+  }
+
+  /**
+   * the usual red-black fix after linking the red node now: while its father
+   * is red too, recolour when the uncle is red and go up, otherwise spin
+   * (twice at most) and stop
+   */
+  inline void FixInsert(TreeNode *now) {
+    while (IsRed(now->father)) {
+      TreeNode *father = now->father, *grand = father->father;
+      if (father == grand->ls) {
+        if (IsRed(grand->rs)) {
+          father->red = grand->rs->red = false, grand->red = true;
+          now = grand;
+          continue;
+        }
+        if (now == father->rs) {
+          RRSpin(Link(father));
+          father = now;
+        }
+        father->red = false, grand->red = true;
+        LLSpin(Link(grand));
       } else {
-        return_node = NodeInsert(now->rs, x, now);
-        maintain(now, x);
+        if (IsRed(grand->ls)) {
+          father->red = grand->ls->red = false, grand->red = true;
+          now = grand;
+          continue;
+        }
+        if (now == father->ls) {
+          LLSpin(Link(father));
+          father = now;
+        }
+        father->red = false, grand->red = true;
+        RRSpin(Link(grand));
       }
+      break;
     }
-    now->height = std::max(GetHeight(now->ls), GetHeight(now->rs)) + 1;
-    return return_node;
+    root->red = false;
   }
 
-  inline bool EraseAdjust(TreeNode *&now, bool direction) {
-    if (!direction) {
-      // true means right
-      if (GetHeight(now->rs) - GetHeight(now->ls) == 1) {
-        // case a : now is balanced
-        return true;
-      }
-      if (GetHeight(now->rs) == GetHeight(now->ls)) {
-        // case b : now is balanced, but it is lowered, check its father!
-        --now->height;
-        return false;
-      }
-      // in the cases below, now isn't balanced
-      if (GetHeight(now->rs->ls) < GetHeight(now->rs->rs)) {
-        // case c : RRSpin, making now lower
-        RRSpin(now);
-        return false;
-      }
-      if (GetHeight(now->rs->ls) > GetHeight(now->rs->rs)) {
-        // case d : RLSpin, making now lower
-        RLSpin(now);
-        return false;
-      }
-      if (GetHeight(now->rs->ls) == GetHeight(now->rs->rs)) {
-        // case e : RRSpin(RLSpin also fits), making it balanced
-        RRSpin(now);
-        return true;
-      }
-    } else {
-      if (GetHeight(now->ls) - GetHeight(now->rs) == 1) {
-        return true;
+  /**
+   * the usual red-black fix after a black node was cut out above son, whose
+   * father is now its_father; son may be nullptr, so its side is told by
+   * its brother, which can't be missing as that side is a black node short
+   */
+  inline void FixErase(TreeNode *son, TreeNode *its_father) {
+    while (son != root && !IsRed(son)) {
+      if (son == its_father->ls) {
+        TreeNode *brother = its_father->rs;
+        if (brother->red) {
+          brother->red = false, its_father->red = true;
+          RRSpin(Link(its_father));
+          brother = its_father->rs;
+        }
+        if (!IsRed(brother->ls) && !IsRed(brother->rs)) {
+          brother->red = true;
+          son = its_father, its_father = son->father;
+          continue;
+        }
+        if (!IsRed(brother->rs)) {
+          brother->ls->red = false, brother->red = true;
+          LLSpin(Link(brother));
+          brother = its_father->rs;
+        }
+        brother->red = its_father->red;
+        its_father->red = brother->rs->red = false;
+        RRSpin(Link(its_father));
+      } else {
+        TreeNode *brother = its_father->ls;
+        if (brother->red) {
+          brother->red = false, its_father->red = true;
+          LLSpin(Link(its_father));
+          brother = its_father->ls;
+        }
+        if (!IsRed(brother->ls) && !IsRed(brother->rs)) {
+          brother->red = true;
+          son = its_father, its_father = son->father;
+          continue;
+        }
+        if (!IsRed(brother->ls)) {
+          brother->rs->red = false, brother->red = true;
+          RRSpin(Link(brother));
+          brother = its_father->ls;
+        }
+        brother->red = its_father->red;
+        its_father->red = brother->ls->red = false;
+        LLSpin(Link(its_father));
       }
-      if (GetHeight(now->ls) == GetHeight(now->rs)) {
-        --now->height;
-        return false;
+      son = root;
+    }
+    if (son) son->red = false;
+  }
+
+  inline void AfterLink(TreeNode *now, avl_tree) {
+    Retrace(now->father);
+  }
+
+  inline void AfterLink(TreeNode *now, red_black_tree) {
+    FixInsert(now);
+  }
+
+  // replace takes the place of now, balance state included
+  inline void TakePlace(TreeNode *replace, TreeNode *now, avl_tree) {
+    replace->height = now->height;
+  }
+
+  // the colours are swapped, so now carries the colour of the place really emptied
+  inline void TakePlace(TreeNode *replace, TreeNode *now, red_black_tree) {
+    std::swap(replace->red, now->red);
+  }
+
+  inline void AfterCut(TreeNode *, TreeNode *, TreeNode *start, avl_tree) {
+    Retrace(start);
+  }
+
+  inline void AfterCut(TreeNode *now, TreeNode *son, TreeNode *start, red_black_tree) {
+    if (!now->red) FixErase(son, start);
+  }
+
+  /**
+   * one descent for key: return the node holding it, or nullptr and leave
+   * in its_father/slot the place where a node for key has to be linked
+   */
+  inline TreeNode *FindSlot(const Key &key, TreeNode *&its_father, TreeNode **&slot) {
+    return FindSlot(key, its_father, slot, three_way_tag());
+  }
+
+  inline TreeNode *FindSlot(const Key &key, TreeNode *&its_father, TreeNode **&slot, my_false_type) {
+    its_father = nullptr, slot = &root;
+    while (*slot) {
+      TreeNode *now = *slot;
+      if (Less(key, now->datum.first)) {
+        slot = &now->ls;
+      } else if (Less(now->datum.first, key)) {
+        slot = &now->rs;
+      } else {
+        return now;
       }
-      if (GetHeight(now->ls->rs) < GetHeight(now->ls->ls)) {
-        LLSpin(now);
-        return false;
+      its_father = now;
+    }
+    return nullptr;
+  }
+
+  inline TreeNode *FindSlot(const Key &key, TreeNode *&its_father, TreeNode **&slot, my_true_type) {
+    its_father = nullptr, slot = &root;
+    while (*slot) {
+      TreeNode *now = *slot;
+      int order = Order(key, now->datum.first);
+      if (order < 0) {
+        slot = &now->ls;
+      } else if (order > 0) {
+        slot = &now->rs;
+      } else {
+        return now;
       }
-      if (GetHeight(now->ls->rs) > GetHeight(now->ls->ls)) {
-        LRSpin(now);
-        return false;
+      its_father = now;
+    }
+    return nullptr;
+  }
+
+  // link now at the slot found by FindSlot, no descent again
+  inline TreeNode *LinkNode(TreeNode *now, TreeNode *its_father, TreeNode **slot) {
+    now->father = its_father, *slot = now;
+    if (!its_father) {
+      leftmost = rightmost = now;
+    } else if (slot == &leftmost->ls) {
+      leftmost = now;
+    } else if (slot == &rightmost->rs) {
+      rightmost = now;
+    }
+    Thread(now, thread_tag());
+    ++capacity;
+    ResizePath(its_father, order_tag());
+    AfterLink(now, balance_tag());
+    return now;
+  }
+
+  // build a new node in place from args and link it at the slot found by FindSlot
+  template<class... Args>
+  inline TreeNode *NodeInsert(TreeNode *its_father, TreeNode **slot, Args &&... args) {
+    return LinkNode(NewNode(its_father, std::forward<Args>(args)...), its_father, slot);
+  }
+
+  // link a node already built, or throw it away if its key is there
+  inline pair<TreeNode *, bool> InsertNode(TreeNode *now) {
+    TreeNode *its_father, **slot;
+    TreeNode *obj = FindSlot(now->datum.first, its_father, slot);
+    if (obj) {
+      FreeNode(now);
+      return pair<TreeNode *, bool>(obj, false);
+    }
+    return pair<TreeNode *, bool>(LinkNode(now, its_father, slot), true);
+  }
+
+  /**
+   * find the slot for key right next to hint (nullptr for end) without a
+   * descent from the root; false if key doesn't belong next to hint
+   * found is set instead if hint holds key
+   */
+  inline bool HintSlot(TreeNode *hint, const Key &key, TreeNode *&found, TreeNode *&its_father, TreeNode **&slot) {
+    found = nullptr;
+    if (!root) return false;
+    if (!hint) {
+      TreeNode *back = Back();
+      if (!Less(back->datum.first, key)) return false;
+      its_father = back, slot = &back->rs;
+      return true;
+    }
+    if (Less(key, hint->datum.first)) {
+      TreeNode *before = hint;
+      Last(before);
+      if (before && !Less(before->datum.first, key)) return false;
+      // if hint has a left son, before is the rightmost one below it
+      if (!hint->ls) {
+        its_father = hint, slot = &hint->ls;
+      } else {
+        its_father = before, slot = &before->rs;
       }
-      if (GetHeight(now->ls->ls) == GetHeight(now->ls->rs)) {
-        LLSpin(now);
-        return true;
+      return true;
+    }
+    if (Less(hint->datum.first, key)) {
+      TreeNode *after = hint;
+      Next(after);
+      if (after && !Less(key, after->datum.first)) return false;
+      if (!hint->rs) {
+        its_father = hint, slot = &hint->rs;
+      } else {
+        its_father = after, slot = &after->ls;
       }
+      return true;
     }
+    found = hint;
+    return true;
   }
 
-  inline bool NodeErase(TreeNode *&now, const Key &x) {
-    if (!now) return true;
-    if (!Compare{}(x, now->datum->first) && !Compare{}(now->datum->first, x)) {
-      if (now->ls && now->rs) {
-        int action_case = 2;
-        // having two sons, requiring replacement
-        TreeNode *replace = now->rs;
-        while (replace->ls) {
-          action_case = 1;
-          replace = replace->ls;
-        }
-        if (action_case == 1) {
-          std::swap(replace->height, now->height);
-          TreeNode *right_son = now->rs, *now_father = now->father;
-          right_son->father = replace;
-          if (replace->rs) {
-            replace->rs->father = now;
-          }
-          if (now->ls) {
-            now->ls->father = replace;
-          }
-          now->rs = replace->rs;
-          replace->rs = right_son, replace->ls = now->ls;
-          now->ls = nullptr;
-          if (replace->father) {
-            replace->father->ls = now;
-          }
-          now->father = replace->father, replace->father = now_father;
-          now->datum->first.~Key(), now->datum->second.~T();
-          new(now->datum) value_type(replace->datum->first, replace->datum->second);
-          now = replace;
+  // own is false if the hint came from another map, then it is ignored
+  template<class V>
+  inline TreeNode *HintInsert(bool own, TreeNode *hint, V &&value) {
+    TreeNode *found, *its_father, **slot;
+    if (!own || !HintSlot(hint, value.first, found, its_father, slot)) {
+      found = FindSlot(value.first, its_father, slot);
+    }
+    if (found) return found;
+    return NodeInsert(its_father, slot, std::forward<V>(value));
+  }
 
-        }
-        if (action_case == 2) {
-          std::swap(now->height, replace->height);
-          now->rs = replace->rs;
-          if (replace->rs) {
-            replace->rs->father = now;
-          }
-          if (now->ls) {
-            now->ls->father = replace;
-          }
-          replace->rs = now, replace->ls = now->ls;
-          now->ls = nullptr;
-          replace->father = now->father, now->father = replace;
-          now->datum->first.~Key(), now->datum->second.~T();
-          new(now->datum) value_type(replace->datum->first, replace->datum->second);
-          now = replace;
-        }
-        // now it manifests that we're deleting in the right subtree
-        if (NodeErase(now->rs, now->datum->first)) {
-          return true;
-        }
-        return EraseAdjust(now, true);
+  /**
+   * turn the first n nodes of chain (in order, linked through rs) into a
+   * perfectly balanced subtree; father and height are set directly,
+   * so no spin is ever needed
+   * every level above the last is full, so for a red-black tree the nodes
+   * red_depth levels down (the last one, if it isn't full) are red and all
+   * the others black
+   */
+  inline TreeNode *BuildTree(TreeNode *&chain, int n, TreeNode *its_father, int red_depth) {
+    if (!n) return nullptr;
+    int left_size = (n - 1) / 2;
+    TreeNode *left = BuildTree(chain, left_size, nullptr, red_depth - 1), *now = chain;
+    chain = chain->rs;
+    now->father = its_father, now->ls = left;
+    if (left) left->father = now;
+    now->rs = BuildTree(chain, n - 1 - left_size, now, red_depth - 1);
+    Refresh(now);
+    Paint(now, !red_depth, balance_tag());
+    return now;
+  }
+
+  inline void Paint(TreeNode *, bool, avl_tree) {}
+
+  inline void Paint(TreeNode *now, bool red, red_black_tree) {
+    now->red = red;
+  }
+
+  template<class K, class... Args>
+  inline pair<TreeNode *, bool> TryEmplace(K &&key, Args &&... args) {
+    TreeNode *its_father, **slot;
+    TreeNode *found = FindSlot(key, its_father, slot);
+    if (found) return pair<TreeNode *, bool>(found, false);
+    // T is only built when a node is really created, right inside the node
+    return pair<TreeNode *, bool>(
+        NodeInsert(its_father, slot, std::piecewise_construct,
+                   std::forward_as_tuple(std::forward<K>(key)),
+                   std::forward_as_tuple(std::forward<Args>(args)...)),
+        true);
+  }
+
+  /**
+   * unlink now from the tree and free it
+   * with two sons, its successor is moved (not copied) into its place,
+   * so iterators to any other node stay valid
+   */
+  inline void EraseNode(TreeNode *now) {
+    UnlinkNode(now);
+    FreeNode(now);
+    --capacity;
+  }
+
+  // the unlinking half of EraseNode: now is kept alive and capacity is left alone
+  inline void UnlinkNode(TreeNode *now) {
+    TreeNode *start, *son;
+    if (now == leftmost) Next(leftmost);
+    if (now == rightmost) Last(rightmost);
+    Unthread(now, thread_tag());
+    if (now->ls && now->rs) {
+      TreeNode *replace = now->rs;
+      while (replace->ls) replace = replace->ls;
+      son = replace->rs;
+      if (replace->father == now) {
+        start = replace;
       } else {
-        // having no/only one son
-        TreeNode *before = now, *before_father = now->father;
-        if (now->ls) {
-          now = now->ls;
-        } else {
-          now = now->rs;
-        }
-        if (now) {
-          now->father = before_father;
-        }
-        delete before;
-        --capacity;
-        return false;// this is because now is lowered
+        start = replace->father;
+        start->ls = replace->rs;
+        if (replace->rs) replace->rs->father = start;
+        replace->rs = now->rs, now->rs->father = replace;
       }
+      replace->ls = now->ls, now->ls->father = replace;
+      Link(now) = replace;
+      replace->father = now->father;
+      TakePlace(replace, now, balance_tag());
     } else {
-      if (Compare{}(x, now->datum->first)) {
-        if (NodeErase(now->ls, x)) {
-          return true;
-        }
-        return EraseAdjust(now, 0);
-      } else {
-        if (NodeErase(now->rs, x)) {
-          return true;
+      son = now->ls ? now->ls : now->rs;
+      Link(now) = son;
+      if (son) son->father = now->father;
+      start = now->father;
+    }
+    ResizePath(start, order_tag());
+    AfterCut(now, son, start, balance_tag());
+  }
+
+  /**
+   * erase the nodes from first up to (not including) last, nullptr for the end
+   * few of them are unlinked one by one, O(log n) each; once that would cost
+   * more than the whole tree, the nodes left are chained in order and built
+   * into a balanced tree again in O(n) instead, like assign does
+   * throw invalid_iterator, with nothing erased, if last doesn't come after first
+   */
+  inline void EraseRange(TreeNode *first, TreeNode *last) {
+    if (first == last) return;
+    if (first == leftmost && !last) {
+      clear();
+      return;
+    }
+    int k = 0;
+    for (TreeNode *walk = first; walk != last; Next(walk)) {
+      if (!walk) throw invalid_iterator();
+      ++k;
+    }
+    int depth = 0;
+    while ((1 << depth) <= capacity) ++depth;
+    // k * depth could overflow an int
+    if (k < capacity / depth) {
+      while (first != last) {
+        TreeNode *next = first;
+        Next(next);
+        EraseNode(first);
+        first = next;
+      }
+      return;
+    }
+    /**
+     * the chains go through ls: the walk still climbs through the fathers and
+     * their rs, and a node's ls isn't looked at again once the walk is past it
+     * the erased ones are freed only after the walk for the same reason
+     */
+    TreeNode *kept = nullptr, *kept_tail = nullptr, *dropped = nullptr;
+    int left = 0;
+    for (TreeNode *now = leftmost, *next; now; now = next) {
+      next = now;
+      Next(next);
+      if (now == first) {
+        for (; now != last; now = next) {
+          next = now;
+          Next(next);
+          now->ls = dropped, dropped = now;
         }
-        return EraseAdjust(now, 1);
+        if (!now) break;
+        next = now;
+        Next(next);
       }
+      now->ls = nullptr;
+      (kept_tail ? kept_tail->ls : kept) = now, kept_tail = now;
+      ++left;
+    }
+    while (dropped) {
+      TreeNode *to_free = dropped;
+      dropped = dropped->ls;
+      FreeNode(to_free);
+    }
+    for (TreeNode *now = kept; now; now = now->rs) now->rs = now->ls;
+    BuildFrom(kept, left);
+  }
+
+  // turn the sorted chain (through rs) of n nodes into a balanced tree
+  inline void BuildFrom(TreeNode *chain, int n) {
+    int full_levels = 0;
+    while ((2 << full_levels) - 1 <= n) ++full_levels;
+    root = BuildTree(chain, n, nullptr, full_levels);
+    capacity = n;
+    ResetEnds();
+  }
+
+  // mid takes l and r as its sons
+  inline void Hang(TreeNode *mid, TreeNode *l, TreeNode *r) {
+    mid->ls = l, mid->rs = r;
+    if (l) l->father = mid;
+    if (r) r->father = mid;
+    Refresh(mid);
+  }
+
+  /**
+   * join the whole trees l and r (either may be nullptr) and the single node
+   * mid, every key in l coming before mid's and every key in r after it
+   * mid goes down the spine of the taller tree to a subtree as tall as the
+   * other tree and takes both as its sons; fixing it up from there costs
+   * O(|height(l) - height(r)| + 1) plus the sizes on the way up
+   * root is only used as scratch by the spins here, the caller sets it
+   */
+  inline TreeNode *JoinTrees(TreeNode *l, TreeNode *mid, TreeNode *r) {
+    if (l) l->father = nullptr;
+    if (r) r->father = nullptr;
+    mid->father = nullptr;
+    return JoinTrees(l, mid, r, balance_tag());
+  }
+
+  inline TreeNode *JoinTrees(TreeNode *l, TreeNode *mid, TreeNode *r, avl_tree) {
+    int left_height = GetHeight(l), right_height = GetHeight(r);
+    TreeNode *its_father;
+    if (left_height > right_height + 1) {
+      its_father = l;
+      while (GetHeight(its_father->rs) > right_height + 1) its_father = its_father->rs;
+      Hang(mid, its_father->rs, r);
+      its_father->rs = mid, root = l;
+    } else if (right_height > left_height + 1) {
+      its_father = r;
+      while (GetHeight(its_father->ls) > left_height + 1) its_father = its_father->ls;
+      Hang(mid, l, its_father->ls);
+      its_father->ls = mid, root = r;
+    } else {
+      Hang(mid, l, r);
+      return mid;
+    }
+    mid->father = its_father;
+    ResizePath(its_father, order_tag());
+    // mid is at most 2 taller than its brother, which Rebalance can take
+    Retrace(its_father);
+    return root;
+  }
+
+  // the black nodes on one way down from now, now included
+  inline static int BlackHeight(const TreeNode *now) {
+    int result = 0;
+    for (; now; now = now->ls) result += !now->red;
+    return result;
+  }
+
+  /**
+   * the black heights aren't kept in the nodes, they are counted along a
+   * spine, so this costs O(log n) and splitting costs O(log^2 n)
+   * mid goes red under a black node (or nullptr) of the taller tree as high
+   * as the other tree, and FixInsert repairs what is above
+   */
+  inline TreeNode *JoinTrees(TreeNode *l, TreeNode *mid, TreeNode *r, red_black_tree) {
+    if (l) l->red = false;
+    if (r) r->red = false;
+    int left_height = BlackHeight(l), right_height = BlackHeight(r);
+    if (left_height == right_height) {
+      Hang(mid, l, r);
+      mid->red = false;
+      return mid;
+    }
+    TreeNode *its_father = nullptr, *now = left_height > right_height ? l : r;
+    int height = std::max(left_height, right_height), wanted = std::min(left_height, right_height);
+    while (height > wanted || IsRed(now)) {
+      if (!IsRed(now)) --height;
+      its_father = now;
+      now = left_height > right_height ? now->rs : now->ls;
+    }
+    if (left_height > right_height) {
+      Hang(mid, now, r);
+      its_father->rs = mid, root = l;
+    } else {
+      Hang(mid, l, now);
+      its_father->ls = mid, root = r;
+    }
+    mid->father = its_father, mid->red = true;
+    ResizePath(its_father, order_tag());
+    FixInsert(mid);
+    return root;
+  }
+
+  /**
+   * split the whole tree now into less, the keys before key, and more, the
+   * keys after it, and return the node holding key itself (nullptr if none)
+   * every node on the way down is joined back into one side: for AVL trees
+   * the costs of these joins add up to O(log n), as the heights telescope
+   * the trees returned may have a red root
+   */
+  template<class K>
+  inline TreeNode *SplitTree(TreeNode *now, const K &key, TreeNode *&less, TreeNode *&more) {
+    if (!now) {
+      less = more = nullptr;
+      return nullptr;
+    }
+    TreeNode *found;
+    if (Less(key, now->datum.first)) {
+      TreeNode *rs = now->rs;
+      found = SplitTree(now->ls, key, less, more);
+      more = JoinTrees(more, now, rs);
+    } else if (Less(now->datum.first, key)) {
+      TreeNode *ls = now->ls;
+      found = SplitTree(now->rs, key, less, more);
+      less = JoinTrees(ls, now, less);
+    } else {
+      less = now->ls, more = now->rs, found = now;
+      if (less) less->father = nullptr;
+      if (more) more->father = nullptr;
+    }
+    return found;
+  }
+
+  /**
+   * unite the whole trees now and other: other is split at the key of its
+   * root, both halves are united with the halves of now and joined back
+   * around it, O(m log(n / m + 1)) for m nodes in other and n in now
+   * a node of other whose key is in now already goes to the end of dups,
+   * a chain through rs in key order, and count counts them
+   */
+  inline TreeNode *Union(TreeNode *now, TreeNode *other, TreeNode *&dups, TreeNode *&dups_tail, int &count) {
+    if (!other) return now;
+    if (!now) return other;
+    TreeNode *ls = other->ls, *rs = other->rs, *less, *more;
+    TreeNode *same = SplitTree(now, other->datum.first, less, more);
+    TreeNode *left = Union(less, ls, dups, dups_tail, count);
+    if (same) {
+      other->rs = nullptr;
+      (dups_tail ? dups_tail->rs : dups) = other, dups_tail = other;
+      ++count;
+    }
+    TreeNode *right = Union(more, rs, dups, dups_tail, count);
+    return JoinTrees(left, same ? same : other, right);
+  }
+
+  // a new root may be red after splitting or joining
+  inline void SetRoot(TreeNode *now) {
+    root = now;
+    if (root) {
+      root->father = nullptr;
+      Paint(root, false, balance_tag());
+    }
+  }
+
+  // leftmost and rightmost again after the tree changed wholesale, O(log n)
+  inline void FindEnds() {
+    leftmost = rightmost = root;
+    if (!root) return;
+    while (leftmost->ls) leftmost = leftmost->ls;
+    while (rightmost->rs) rightmost = rightmost->rs;
+  }
+
+  // the number of nodes before first, which has to be in the tree
+  inline int CountBefore(TreeNode *first, my_true_type) const {
+    return Rank(first, my_true_type());
+  }
+
+  // walks from both ends of the cut at once, so it costs O(min(k, n - k))
+  inline int CountBefore(TreeNode *first, my_false_type) const {
+    TreeNode *front = leftmost, *back = first;
+    for (int walked = 0;; ++walked) {
+      if (front == first) return walked;
+      if (!back) return capacity - walked;
+      Next(front), Next(back);
     }
   }
 
+  // the thread is cut in front of first
+  inline void CutThread(TreeNode *first, my_true_type) {
+    if (first->prev) first->prev->next = nullptr;
+    first->prev = nullptr;
+  }
+
+  inline void CutThread(TreeNode *, my_false_type) {}
+
+  // mid is threaded in between before and after, the ends of two threads
+  inline void StitchThread(TreeNode *before, TreeNode *mid, TreeNode *after, my_true_type) {
+    mid->prev = before, mid->next = after;
+    if (before) before->next = mid;
+    if (after) after->prev = mid;
+  }
+
+  inline void StitchThread(TreeNode *, TreeNode *, TreeNode *, my_false_type) {}
+
+  // other gives all its nodes to this map: it is left empty, without touching them
+  inline void Adopt(map &other) {
+    other.root = other.leftmost = other.rightmost = nullptr;
+    other.capacity = 0;
+    pool.Adopt(other.pool);
+  }
+
   inline void Next(TreeNode *&now) const {
+    Next(now, thread_tag());
+  }
+
+  inline void Last(TreeNode *&now) const {
+    Last(now, thread_tag());
+  }
+
+  inline void Next(TreeNode *&now, my_true_type) const {
+    if (now) now = now->next;
+  }
+
+  inline void Last(TreeNode *&now, my_true_type) const {
+    if (now) now = now->prev;
+  }
+
+  // the in-order neighbours found through the tree itself, valid with or without threads
+  inline void Next(TreeNode *&now, my_false_type) const {
     if (!now) {
       return;
     }
@@ -362,7 +1411,7 @@ class map {
     }
   }
 
-  inline void Last(TreeNode *&now) const {
+  inline void Last(TreeNode *&now, my_false_type) const {
     if (!now) {
       return;
     }
@@ -380,18 +1429,179 @@ class map {
     }
   }
 
-  inline TreeNode *First() const {
-    TreeNode *now = root;
-    if (!now) return nullptr;
-    while (now->ls) now = now->ls;
+  // splice now into the thread, its neighbours are found through its father
+  inline void Thread(TreeNode *now, my_true_type) {
+    TreeNode *its_father = now->father;
+    if (!its_father) {
+      now->prev = now->next = nullptr;
+      return;
+    }
+    if (its_father->ls == now) {
+      now->next = its_father, now->prev = its_father->prev;
+    } else {
+      now->prev = its_father, now->next = its_father->next;
+    }
+    if (now->prev) now->prev->next = now;
+    if (now->next) now->next->prev = now;
+  }
+
+  inline void Thread(TreeNode *, my_false_type) {}
+
+  inline void Unthread(TreeNode *now, my_true_type) {
+    if (now->prev) now->prev->next = now->next;
+    if (now->next) now->next->prev = now->prev;
+  }
+
+  inline void Unthread(TreeNode *, my_false_type) {}
+
+  // thread a whole tree built in one go (copied or bulk built) in one walk
+  inline void ThreadAll(my_true_type) {
+    TreeNode *before = nullptr;
+    for (TreeNode *now = leftmost; now; Next(now, my_false_type())) {
+      now->prev = before, now->next = nullptr;
+      if (before) before->next = now;
+      before = now;
+    }
+  }
+
+  inline void ThreadAll(my_false_type) {}
+
+  // the first node whose key is not less than key, nullptr if there is none
+  template<class K>
+  inline TreeNode *LowerBound(const K &key) const {
+    TreeNode *now = root, *result = nullptr;
+    while (now) {
+      if (Less(now->datum.first, key)) {
+        now = now->rs;
+      } else {
+        result = now, now = now->ls;
+      }
+    }
+    return result;
+  }
+
+  // the first node whose key is greater than key, nullptr if there is none
+  template<class K>
+  inline TreeNode *UpperBound(const K &key) const {
+    TreeNode *now = root, *result = nullptr;
+    while (now) {
+      if (Less(key, now->datum.first)) {
+        result = now, now = now->ls;
+      } else {
+        now = now->rs;
+      }
+    }
+    return result;
+  }
+
+  inline int CountRange(const Key &lo, const Key &hi, my_true_type) const {
+    if (!Less(lo, hi)) return 0;
+    return KeyRank(hi, my_true_type()) - KeyRank(lo, my_true_type());
+  }
+
+  inline int CountRange(const Key &lo, const Key &hi, my_false_type) const {
+    int result = 0;
+    for (TreeNode *walk = LowerBound(lo); walk && Less(walk->datum.first, hi); Next(walk)) ++result;
+    return result;
+  }
+
+  // the node with k nodes before it, nullptr if there is none
+  inline TreeNode *Select(int k, my_true_type) const {
+    TreeNode *now = k < 0 ? nullptr : root;
+    while (now) {
+      int left = GetSize(now->ls, my_true_type());
+      if (k < left) {
+        now = now->ls;
+      } else if (k == left) {
+        return now;
+      } else {
+        k -= left + 1, now = now->rs;
+      }
+    }
+    return nullptr;
+  }
+
+  inline TreeNode *Select(int k, my_false_type) const {
+    if (k < 0 || k >= capacity) return nullptr;
+    TreeNode *now = First();
+    while (k--) Next(now);
     return now;
   }
 
-  inline TreeNode *Back() const {
+  // the number of nodes before now, where end (nullptr) comes after all of them
+  inline int Rank(const TreeNode *now, my_true_type) const {
+    if (!now) return capacity;
+    int result = GetSize(now->ls, my_true_type());
+    for (; now->father; now = now->father) {
+      if (now->father->rs == now) result += GetSize(now->father->ls, my_true_type()) + 1;
+    }
+    return result;
+  }
+
+  inline int Rank(const TreeNode *now, my_false_type) const {
+    int result = 0;
+    for (TreeNode *walk = First(); walk != now; Next(walk)) ++result;
+    return result;
+  }
+
+  // the number of keys less than key
+  inline int KeyRank(const Key &key, my_true_type) const {
     TreeNode *now = root;
-    if (!now) return nullptr;
-    while (now->rs) now = now->rs;
-    return now;
+    int result = 0;
+    while (now) {
+      if (Less(now->datum.first, key)) {
+        result += GetSize(now->ls, my_true_type()) + 1;
+        now = now->rs;
+      } else {
+        now = now->ls;
+      }
+    }
+    return result;
+  }
+
+  inline int KeyRank(const Key &key, my_false_type) const {
+    int result = 0;
+    for (TreeNode *walk = First(); walk && Less(walk->datum.first, key); Next(walk)) ++result;
+    return result;
+  }
+
+  // move now by n places, throw if it would leave [begin, end]
+  inline void Advance(TreeNode *&now, std::ptrdiff_t n, my_true_type) const {
+    std::ptrdiff_t target = Rank(now, my_true_type()) + n;
+    if (target < 0 || target > capacity) throw invalid_iterator();
+    now = Select(int(target), my_true_type());
+  }
+
+  inline void Advance(TreeNode *&now, std::ptrdiff_t n, my_false_type) const {
+    for (; n > 0; --n) {
+      if (!now) throw invalid_iterator();
+      Next(now);
+    }
+    for (; n < 0; ++n) {
+      if (!root || now == First()) throw invalid_iterator();
+      if (!now) {
+        now = Back();
+      } else {
+        Last(now);
+      }
+    }
+  }
+
+  inline TreeNode *First() const {
+    return leftmost;
+  }
+
+  inline TreeNode *Back() const {
+    return rightmost;
+  }
+
+  // find leftmost/rightmost (and the threads) again after a whole tree was built in one go
+  inline void ResetEnds() {
+    leftmost = rightmost = root;
+    if (!root) return;
+    while (leftmost->ls) leftmost = leftmost->ls;
+    while (rightmost->rs) rightmost = rightmost->rs;
+    ThreadAll(thread_tag());
   }
  public:
   /**
@@ -403,7 +1613,7 @@ class map {
   class iterator {
    private:
     TreeNode *node;
-    const map<Key, T, Compare> *from;
+    const map *from;
    public:
     // The following code is written for the C++ type_traits library.
     // Type traits is a C++ feature for describing certain properties of a type.
@@ -474,9 +1684,30 @@ class map {
       }
     }
 
+    /**
+     * jumps and distances are O(log n) with order_statistics,
+     * and take one step at a time without it
+     */
+    iterator &operator+=(difference_type n) {
+      if (!from) throw invalid_iterator();
+      from->Advance(node, n, order_tag());
+      return *this;
+    }
+
+    iterator &operator-=(difference_type n) {
+      if (!from) throw invalid_iterator();
+      from->Advance(node, -n, order_tag());
+      return *this;
+    }
+
+    difference_type operator-(const iterator &rhs) const {
+      if (!from || from != rhs.from) throw invalid_iterator();
+      return difference_type(from->Rank(node, order_tag())) - from->Rank(rhs.node, order_tag());
+    }
+
     value_type &operator*() const {
       if (!node) throw invalid_iterator();
-      return *(node->datum);
+      return node->datum;
     }
 
     bool operator==(const iterator &rhs) const {
@@ -497,13 +1728,13 @@ class map {
 
     value_type *operator->() const noexcept {
       if (!node) throw invalid_iterator();
-      return node->datum;
+      return &node->datum;
     }
   };
   class const_iterator {
    private:
     TreeNode *node;
-    const map<Key, T, Compare> *from;
+    const map *from;
    public:
     friend class map;
     using iterator_assignable = my_false_type;
@@ -556,9 +1787,26 @@ class map {
       }
     }
 
+    const_iterator &operator+=(std::ptrdiff_t n) {
+      if (!from) throw invalid_iterator();
+      from->Advance(node, n, order_tag());
+      return *this;
+    }
+
+    const_iterator &operator-=(std::ptrdiff_t n) {
+      if (!from) throw invalid_iterator();
+      from->Advance(node, -n, order_tag());
+      return *this;
+    }
+
+    std::ptrdiff_t operator-(const const_iterator &rhs) const {
+      if (!from || from != rhs.from) throw invalid_iterator();
+      return std::ptrdiff_t(from->Rank(node, order_tag())) - from->Rank(rhs.node, order_tag());
+    }
+
     value_type &operator*() const {
       if (!node) throw invalid_iterator();
-      return *(node->datum);
+      return node->datum;
     }
     bool operator==(const const_iterator &rhs) const {
       return (from == rhs.from && node == rhs.node);
@@ -577,56 +1825,163 @@ class map {
 
     value_type *operator->() const noexcept {
       if (!node) throw invalid_iterator();
-      return node->datum;
+      return &node->datum;
     }
   };
 
-  map() : capacity(0), root(nullptr) {}
+  map() : capacity(0), root(nullptr), leftmost(nullptr), rightmost(nullptr) {}
+
+  explicit map(const Allocator &alloc) : capacity(0), root(nullptr), leftmost(nullptr), rightmost(nullptr), pool(alloc) {}
+
+  explicit map(const Compare &comp, const Allocator &alloc = Allocator())
+      : compare_base<Compare>(comp), capacity(0), root(nullptr), leftmost(nullptr), rightmost(nullptr), pool(alloc) {}
+
+  template<class InputIterator>
+  map(InputIterator first, InputIterator last, const Compare &comp = Compare(), const Allocator &alloc = Allocator())
+      : compare_base<Compare>(comp), capacity(0), root(nullptr), leftmost(nullptr), rightmost(nullptr), pool(alloc) {
+    assign(first, last);
+  }
 
-  map(const map &other) : capacity(other.capacity) {
-    if (this == &other) return;
-    CopyNode(root, other.root);
+  map(const map &other)
+      : compare_base<Compare>(other.KeyComp()), capacity(other.capacity), root(nullptr), leftmost(nullptr), rightmost(nullptr),
+        pool(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.get_allocator())) {
+    try {
+      // all the nodes in one slab
+      pool.Reserve(other.capacity);
+      CopyNode(root, other.root);
+    } catch (...) {
+      ReleaseTree();
+      throw;
+    }
+    ResetEnds();
   }
 
+  // the slabs of the old tree are reused for the copy, and topped up in one slab if too small
   map &operator=(const map &other) {
     if (this == &other) return *this;
-    DeleteNode(root), CopyNode(root, other.root);
+    ReleaseTree(true), capacity = 0;
+    this->KeyComp() = other.KeyComp();
+    try {
+      pool.Reserve(other.capacity);
+      CopyNode(root, other.root);
+    } catch (...) {
+      ReleaseTree();
+      throw;
+    }
+    ResetEnds();
     capacity = other.capacity;
     return *this;
   }
 
+  /**
+   * moving and swapping only hand the nodes over together with their slabs,
+   * nothing is copied or allocated
+   * the nodes stay where they are, but iterators remember the map they came
+   * from, so iterators into a moved or swapped map must not be used any more
+   */
+  map(map &&other) noexcept
+      : compare_base<Compare>(other.KeyComp()), capacity(other.capacity), root(other.root), leftmost(other.leftmost), rightmost(other.rightmost),
+        pool(std::move(other.pool)) {
+    other.capacity = 0;
+    other.root = other.leftmost = other.rightmost = nullptr;
+  }
+
+  map &operator=(map &&other) noexcept {
+    if (this == &other) return *this;
+    ReleaseTree(), capacity = 0;
+    swap(other);
+    return *this;
+  }
+
+  void swap(map &other) noexcept {
+    std::swap(this->KeyComp(), other.KeyComp());
+    std::swap(capacity, other.capacity);
+    std::swap(root, other.root);
+    std::swap(leftmost, other.leftmost), std::swap(rightmost, other.rightmost);
+    pool.swap(other.pool);
+  }
+
   ~map() {
-    DeleteNode(root);
+    ReleaseTree();
+  }
+
+  // a copy of the comparator the keys are ordered by
+  key_compare key_comp() const {
+    return this->KeyComp();
+  }
+
+  value_compare value_comp() const {
+    return value_compare(this->KeyComp());
+  }
+
+  /**
+   * replace the contents with [first, last)
+   * as long as the input is sorted it is only chained up and then turned
+   * into a balanced tree in linear time; the first element out of order and
+   * everything after it are inserted one by one
+   * like insert, the first of several equal keys wins
+   */
+  template<class InputIterator>
+  void assign(InputIterator first, InputIterator last) {
+    clear();
+    TreeNode *chain = nullptr, *tail = nullptr, *rest = nullptr;
+    int chained = 0;
+    try {
+      for (; first != last; ++first) {
+        TreeNode *now = NewNode(nullptr, *first);
+        if (tail && !Less(tail->datum.first, now->datum.first)) {
+          if (Less(now->datum.first, tail->datum.first)) {
+            rest = now, ++first;
+            break;
+          }
+          FreeNode(now);
+          continue;
+        }
+        (tail ? tail->rs : chain) = now, tail = now;
+        ++chained;
+      }
+    } catch (...) {
+      while (chain) {
+        TreeNode *to_free = chain;
+        chain = chain->rs;
+        FreeNode(to_free);
+      }
+      throw;
+    }
+    BuildFrom(chain, chained);
+    if (!rest) return;
+    InsertNode(rest);
+    for (; first != last; ++first) emplace(*first);
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(pool.get_allocator());
   }
 
   T &at(const Key &key) {
     TreeNode *exist = FindValue(root, key);
     if (!exist) throw index_out_of_bound();
-    return exist->datum->second;
+    return exist->datum.second;
   }
 
   const T &at(const Key &key) const {
     TreeNode *exist = FindValue(root, key);
     if (!exist) throw index_out_of_bound();
-    return exist->datum->second;
+    return exist->datum.second;
   }
 
   T &operator[](const Key &key) {
-    T todo;
-    TreeNode *found = FindValue(root, key);
-    if (found) {
-      return found->datum->second;
-    } else {
-      ++capacity;
-      TreeNode *to_insert = NodeInsert(root, sjtu::pair<Key, T>(key, todo), nullptr);
-      return to_insert->datum->second;
-    }
+    return TryEmplace(key).first->datum.second;
+  }
+
+  T &operator[](Key &&key) {
+    return TryEmplace(std::move(key)).first->datum.second;
   }
 
   const T &operator[](const Key &key) const {
     TreeNode *exist = FindValue(root, key);
     if (!exist) throw index_out_of_bound();
-    return exist->datum->second;
+    return exist->datum.second;
   }
 
   iterator begin() {
@@ -654,26 +2009,196 @@ class map {
 
   void clear() {
     capacity = 0;
-    DeleteNode(root);
+    ReleaseTree();
   }
 
   pair<iterator, bool> insert(const value_type &value) {
-    TreeNode *obj = FindValue(root, value.first);
+    TreeNode *its_father, **slot;
+    TreeNode *obj = FindSlot(value.first, its_father, slot);
     if (obj) {
       // insert fail
       return sjtu::pair<iterator, bool>(iterator(obj, this), false);
+    }
+    return sjtu::pair<iterator, bool>(iterator(NodeInsert(its_father, slot, value), this), true);
+  }
+
+  pair<iterator, bool> insert(value_type &&value) {
+    TreeNode *its_father, **slot;
+    TreeNode *obj = FindSlot(value.first, its_father, slot);
+    if (obj) {
+      return sjtu::pair<iterator, bool>(iterator(obj, this), false);
+    }
+    return sjtu::pair<iterator, bool>(iterator(NodeInsert(its_father, slot, std::move(value)), this), true);
+  }
+
+  /**
+   * the pair is built inside a new node first, since its key is only known then
+   * if the key is already there, the node is thrown away
+   */
+  template<class... Args>
+  pair<iterator, bool> emplace(Args &&... args) {
+    pair<TreeNode *, bool> result = InsertNode(NewNode(nullptr, std::forward<Args>(args)...));
+    return sjtu::pair<iterator, bool>(iterator(result.first, this), result.second);
+  }
+
+  /**
+   * like emplace, but nothing is built (and args are left untouched) if key
+   * is already there; otherwise the mapped value is built in place from args
+   */
+  template<class... Args>
+  pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+    pair<TreeNode *, bool> result = TryEmplace(key, std::forward<Args>(args)...);
+    return sjtu::pair<iterator, bool>(iterator(result.first, this), result.second);
+  }
+
+  template<class... Args>
+  pair<iterator, bool> try_emplace(Key &&key, Args &&... args) {
+    pair<TreeNode *, bool> result = TryEmplace(std::move(key), std::forward<Args>(args)...);
+    return sjtu::pair<iterator, bool>(iterator(result.first, this), result.second);
+  }
+
+  /**
+   * insert value right next to hint, amortized O(1) if it belongs there
+   * (just before hint, or after the last element if hint is end())
+   * a wrong hint costs one descent from the root, like insert(value)
+   */
+  iterator insert(const_iterator hint, const value_type &value) {
+    return iterator(HintInsert(hint.from == this, hint.node, value), this);
+  }
+
+  iterator insert(const_iterator hint, value_type &&value) {
+    return iterator(HintInsert(hint.from == this, hint.node, std::move(value)), this);
+  }
+
+  /**
+   * erase the element at pos, unlinked right where it is
+   * return an iterator to the element after it
+   * throw invalid_iterator if pos is end() or belongs to another map
+   */
+  iterator erase(iterator pos) {
+    return erase(const_iterator(pos));
+  }
+
+  iterator erase(const_iterator pos) {
+    if (pos.from != this || !pos.node) throw invalid_iterator();
+    TreeNode *next = pos.node;
+    Next(next);
+    EraseNode(pos.node);
+    return iterator(next, this);
+  }
+
+  /**
+   * erase [first, last) and return last
+   * O(k log n) for k elements, but never more than O(n), see EraseRange
+   * throw invalid_iterator if they belong to another map or last is before first
+   */
+  iterator erase(const_iterator first, const_iterator last) {
+    if (first.from != this || last.from != this) throw invalid_iterator();
+    EraseRange(first.node, last.node);
+    return iterator(last.node, this);
+  }
+
+  // the number of elements erased, 0 or 1
+  int erase(const Key &key) {
+    TreeNode *now = FindValue(root, key);
+    if (!now) return 0;
+    EraseNode(now);
+    return 1;
+  }
+
+  /**
+   * move the elements whose keys are not less than key into a new map and
+   * return it; no element is copied, the nodes are handed over as they are
+   * O(log n) spins for the AVL tree, O(log^2 n) for the red-black one (see
+   * JoinTrees), plus counting the two parts: O(log n) with order statistics,
+   * O(min(k, n - k)) steps without
+   * the two maps share the slabs of their nodes from then on: the memory goes
+   * back once both are gone or joined again (see node_pool)
+   * iterators to the moved elements are invalid afterwards
+   */
+  map split(const Key &key) {
+    map result(this->KeyComp(), get_allocator());
+    TreeNode *first = LowerBound(key);
+    if (!first) return result;
+    if (first == leftmost) {
+      swap(result);
+      return result;
+    }
+    result.pool.Share(pool);
+    pool.GiveFree(result.pool);
+    int before = CountBefore(first, order_tag());
+    CutThread(first, thread_tag());
+    TreeNode *less, *more;
+    TreeNode *found = SplitTree(root, key, less, more);
+    if (found) more = JoinTrees(nullptr, found, more);
+    SetRoot(less), result.SetRoot(more);
+    result.capacity = capacity - before, capacity = before;
+    FindEnds(), result.FindEnds();
+    return result;
+  }
+
+  /**
+   * move every element of other into this map, other is left empty
+   * when all the keys of other come after all the keys here (or all before),
+   * the trees are joined around one node in O(log n), plus taking over the
+   * free slots of other (see node_pool::Adopt)
+   * otherwise (or with allocators that differ) this is merge(other)
+   */
+  void join(map &other) {
+    if (&other == this || !other.root) return;
+    if (!root || !(pool.get_allocator() == other.pool.get_allocator())) {
+      merge(other);
+      return;
+    }
+    bool after = Less(rightmost->datum.first, other.leftmost->datum.first);
+    if (!after && !Less(other.rightmost->datum.first, leftmost->datum.first)) {
+      merge(other);
+      return;
+    }
+    pool.Share(other.pool);
+    // the node in between comes off the near end of other
+    TreeNode *mid = after ? other.leftmost : other.rightmost;
+    other.UnlinkNode(mid);
+    if (after) {
+      StitchThread(rightmost, mid, other.leftmost, thread_tag());
+      SetRoot(JoinTrees(root, mid, other.root));
     } else {
-      ++capacity;
-      return sjtu::pair<iterator, bool>(iterator(NodeInsert(root, value, nullptr), this), true);
+      StitchThread(other.rightmost, mid, leftmost, thread_tag());
+      SetRoot(JoinTrees(other.root, mid, root));
     }
+    capacity += other.capacity;
+    Adopt(other);
+    FindEnds();
   }
 
-  void erase(iterator pos) {
-    // the setting of bool is to check whether spinning is required
-    if (pos.from != this || !pos.node) {
-      throw 1;
+  /**
+   * move the elements of other whose keys are not here yet into this map,
+   * the others stay in other, like std::map::merge
+   * the trees are united by splitting and joining (see Union), so for m
+   * elements in other and n here it costs O(m log(n / m + 1)) compares and
+   * no element is copied; a threaded map rethreads in O(n + m) on top
+   * with allocators that differ the elements are copied over one by one
+   */
+  void merge(map &other) {
+    if (&other == this || !other.root) return;
+    if (!(pool.get_allocator() == other.pool.get_allocator())) {
+      for (TreeNode *now = other.leftmost, *next; now; now = next) {
+        next = now;
+        other.Next(next);
+        if (TryEmplace(now->datum.first, now->datum.second).second) other.EraseNode(now);
+      }
+      return;
+    }
+    pool.Share(other.pool);
+    TreeNode *dups = nullptr, *dups_tail = nullptr;
+    int dup_count = 0;
+    SetRoot(Union(root, other.root, dups, dups_tail, dup_count));
+    capacity += other.capacity - dup_count;
+    ResetEnds();
+    if (dup_count) {
+      other.BuildFrom(dups, dup_count);
     } else {
-      NodeErase(root, pos.node->datum->first);
+      Adopt(other);
     }
   }
 
@@ -688,6 +2213,139 @@ class map {
   const_iterator find(const Key &key) const {
     return const_iterator(FindValue(root, key), this);
   }
+
+  iterator lower_bound(const Key &key) {
+    return iterator(LowerBound(key), this);
+  }
+
+  const_iterator lower_bound(const Key &key) const {
+    return const_iterator(LowerBound(key), this);
+  }
+
+  iterator upper_bound(const Key &key) {
+    return iterator(UpperBound(key), this);
+  }
+
+  const_iterator upper_bound(const Key &key) const {
+    return const_iterator(UpperBound(key), this);
+  }
+
+  pair<iterator, iterator> equal_range(const Key &key) {
+    return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+  }
+
+  pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+    return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+  }
+
+  /**
+   * heterogeneous lookup: with a transparent Compare (one that has an
+   * is_transparent member type, like std::less<>), the lookups below take
+   * any K that Compare can compare with Key both ways round, e.g. a const
+   * char * for std::string keys, and never make a Key out of it
+   * K has to order the keys the same way a Key made out of it would
+   */
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  T &at(const K &key) {
+    TreeNode *exist = FindValue(root, key);
+    if (!exist) throw index_out_of_bound();
+    return exist->datum.second;
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  const T &at(const K &key) const {
+    TreeNode *exist = FindValue(root, key);
+    if (!exist) throw index_out_of_bound();
+    return exist->datum.second;
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  int count(const K &key) const {
+    return FindValue(root, key) ? 1 : 0;
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  iterator find(const K &key) {
+    return iterator(FindValue(root, key), this);
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  const_iterator find(const K &key) const {
+    return const_iterator(FindValue(root, key), this);
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  iterator lower_bound(const K &key) {
+    return iterator(LowerBound(key), this);
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  const_iterator lower_bound(const K &key) const {
+    return const_iterator(LowerBound(key), this);
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  iterator upper_bound(const K &key) {
+    return iterator(UpperBound(key), this);
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  const_iterator upper_bound(const K &key) const {
+    return const_iterator(UpperBound(key), this);
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  pair<iterator, iterator> equal_range(const K &key) {
+    return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+  }
+
+  template<class K, class C = Compare, class = typename C::is_transparent>
+  pair<const_iterator, const_iterator> equal_range(const K &key) const {
+    return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+  }
+
+  // like erase(const Key &); iterators are left to erase(pos)
+  template<class K, class C = Compare, class = typename C::is_transparent,
+      class = typename std::enable_if<!std::is_convertible<K, const_iterator>::value>::type>
+  int erase(const K &key) {
+    TreeNode *now = FindValue(root, key);
+    if (!now) return 0;
+    EraseNode(now);
+    return 1;
+  }
+
+  /**
+   * the number of keys in [lo, hi)
+   * O(log n) with order_statistics in Policy, O(log n + answer) without
+   */
+  int count_range(const Key &lo, const Key &hi) const {
+    return CountRange(lo, hi, order_tag());
+  }
+
+  /**
+   * the k-th smallest element (counting from 0), or end() if k is out of range
+   * O(log n) with order_statistics in Policy, O(k) without
+   */
+  iterator nth(int k) {
+    return iterator(Select(k, order_tag()), this);
+  }
+
+  const_iterator nth(int k) const {
+    return const_iterator(Select(k, order_tag()), this);
+  }
+
+  /**
+   * the number of keys less than key, i.e. where key is or would be in the order
+   * O(log n) with order_statistics in Policy, O(n) without
+   */
+  int rank(const Key &key) const {
+    return KeyRank(key, order_tag());
+  }
 };
+
+template<class Key, class T, class Compare, class Allocator, class Policy>
+void swap(map<Key, T, Compare, Allocator, Policy> &one, map<Key, T, Compare, Allocator, Policy> &another) noexcept {
+  one.swap(another);
+}
 }
 #endif
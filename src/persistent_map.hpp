@@ -0,0 +1,517 @@
+/**
+ * a persistent version of the AVL map in map.hpp
+ * every version is immutable: insert and erase leave the map they are
+ * called on alone and return a new version, which copies only the O(log n)
+ * nodes on the way down and shares every other subtree with the old one
+ * so taking a snapshot is just copying a persistent_map, which is O(1)
+ */
+#ifndef SJTU_PERSISTENT_MAP_HPP
+#define SJTU_PERSISTENT_MAP_HPP
+
+// only for std::less<T>
+#include <functional>
+// only for std::allocator<T> and std::allocator_traits<A>
+#include <memory>
+// only for std::atomic<T>
+#include <atomic>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+// only for compare_base<C>
+#include "map.hpp"
+
+/**
+ * sharing:
+ *   a node is shared by every version (and every node) pointing to it, and
+ *   counts them in refs; the last one to let go frees it, and lets go of its sons
+ *   the counts are atomic, so versions sharing nodes may live in different
+ *   threads, e.g. readers iterating over snapshots while a writer keeps making
+ *   new versions; one persistent_map object is no more thread safe than an int
+ *   a node only referenced once, by a node made for the version being built,
+ *   can't be seen by anyone else, so it is changed in place instead of copied
+ *
+ * differences from sjtu::map:
+ *   nodes don't know their father (they can have many), so iterators keep the
+ *   way down from the root and are bigger; they are all const_iterators and
+ *   stay valid as long as the version they came from
+ *   nodes are allocated one by one, nodes made by one version may be freed by
+ *   another one, so copies of Allocator have to be able to free each other's memory
+ *   every version made from this one keeps its comparator
+ */
+
+namespace sjtu {
+
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<pair<const Key, T>>
+>
+class persistent_map : private compare_base<Compare> {
+ public:
+  typedef pair<const Key, T> value_type;
+  typedef Allocator allocator_type;
+  typedef Compare key_compare;
+  // orders values by their keys, what value_comp() hands out
+  class value_compare {
+   protected:
+    Compare comp;
+    explicit value_compare(const Compare &_comp) : comp(_comp) {}
+   public:
+    friend class persistent_map;
+    bool operator()(const value_type &one, const value_type &another) const {
+      return comp(one.first, another.first);
+    }
+  };
+ private:
+  // an AVL tree with less than 2^31 nodes is at most 45 high
+  static constexpr int max_height = 48;
+
+  struct TreeNode {
+    TreeNode *ls, *rs;
+    int height;
+    std::atomic<int> refs;
+    value_type datum;
+    template<class... Args>
+    explicit TreeNode(TreeNode *_ls, TreeNode *_rs, Args &&... args)
+        : ls(_ls), rs(_rs), height(1), refs(1), datum(std::forward<Args>(args)...) {}
+  };
+
+  using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  TreeNode *root;
+  int capacity;
+  node_allocator alloc;
+
+  persistent_map(TreeNode *_root, int _capacity, const Compare &comp, const node_allocator &_alloc)
+      : compare_base<Compare>(comp), root(_root), capacity(_capacity), alloc(_alloc) {}
+
+  inline bool Less(const Key &one, const Key &another) const {
+    return this->KeyComp()(one, another);
+  }
+
+  inline static int GetHeight(const TreeNode *obj) {
+    return obj ? obj->height : 0;
+  }
+
+  inline static void Refresh(TreeNode *now) {
+    now->height = std::max(GetHeight(now->ls), GetHeight(now->rs)) + 1;
+  }
+
+  inline static TreeNode *Retain(TreeNode *now) {
+    if (now) now->refs.fetch_add(1, std::memory_order_relaxed);
+    return now;
+  }
+
+  // the sons are owned by the new node from now on, even if building it throws
+  template<class... Args>
+  inline TreeNode *NewNode(TreeNode *ls, TreeNode *rs, Args &&... args) {
+    TreeNode *now = node_traits::allocate(alloc, 1);
+    try {
+      new(now) TreeNode(ls, rs, std::forward<Args>(args)...);
+    } catch (...) {
+      node_traits::deallocate(alloc, now, 1);
+      Release(ls), Release(rs);
+      throw;
+    }
+    Refresh(now);
+    return now;
+  }
+
+  // let go of now; the sons are let go of one by one as the tree is at most 45 high
+  inline void Release(TreeNode *now) {
+    if (!now || now->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    TreeNode *ls = now->ls, *rs = now->rs;
+    now->~TreeNode();
+    node_traits::deallocate(alloc, now, 1);
+    Release(ls), Release(rs);
+  }
+
+  // make the node in slot one that only the version being built sees
+  inline void Unique(TreeNode *&slot) {
+    if (slot->refs.load(std::memory_order_acquire) == 1) return;
+    TreeNode *copy = NewNode(Retain(slot->ls), Retain(slot->rs), slot->datum);
+    Release(slot);
+    slot = copy;
+  }
+
+  /**
+   * the spins only touch nodes owned by the version being built,
+   * sons that are still shared get copied first
+   */
+  inline void LLSpin(TreeNode *&now) {
+    Unique(now->ls);
+    TreeNode *after = now->ls;
+    now->ls = after->rs, after->rs = now;
+    Refresh(now), Refresh(after);
+    now = after;
+  }
+
+  inline void RRSpin(TreeNode *&now) {
+    Unique(now->rs);
+    TreeNode *after = now->rs;
+    now->rs = after->ls, after->ls = now;
+    Refresh(now), Refresh(after);
+    now = after;
+  }
+
+  inline void LRSpin(TreeNode *&now) {
+    Unique(now->ls);
+    RRSpin(now->ls);
+    LLSpin(now);
+  }
+
+  inline void RLSpin(TreeNode *&now) {
+    Unique(now->rs);
+    LLSpin(now->rs);
+    RRSpin(now);
+  }
+
+  // now is owned by the version being built; if a spin throws, it is let go of
+  inline TreeNode *Rebalance(TreeNode *now) {
+    try {
+      int diff = GetHeight(now->ls) - GetHeight(now->rs);
+      if (diff > 1) {
+        if (GetHeight(now->ls->ls) >= GetHeight(now->ls->rs)) {
+          LLSpin(now);
+        } else {
+          LRSpin(now);
+        }
+      } else if (diff < -1) {
+        if (GetHeight(now->rs->rs) >= GetHeight(now->rs->ls)) {
+          RRSpin(now);
+        } else {
+          RLSpin(now);
+        }
+      } else {
+        Refresh(now);
+      }
+    } catch (...) {
+      Release(now);
+      throw;
+    }
+    return now;
+  }
+
+  /**
+   * the subtree now with value in it, as a new node owned by the caller
+   * nullptr and changed left false if nothing had to change: key is there and
+   * overwrite is false
+   */
+  template<class V>
+  TreeNode *Insert(TreeNode *now, V &&value, bool overwrite, bool &changed, bool &added) {
+    if (!now) {
+      changed = added = true;
+      return NewNode(nullptr, nullptr, std::forward<V>(value));
+    }
+    if (Less(value.first, now->datum.first)) {
+      TreeNode *left = Insert(now->ls, std::forward<V>(value), overwrite, changed, added);
+      if (!changed) return nullptr;
+      return Rebalance(NewNode(left, Retain(now->rs), now->datum));
+    }
+    if (Less(now->datum.first, value.first)) {
+      TreeNode *right = Insert(now->rs, std::forward<V>(value), overwrite, changed, added);
+      if (!changed) return nullptr;
+      return Rebalance(NewNode(Retain(now->ls), right, now->datum));
+    }
+    if (!overwrite) return nullptr;
+    changed = true;
+    return NewNode(Retain(now->ls), Retain(now->rs), std::forward<V>(value));
+  }
+
+  // the subtree now without its least node, which is handed out in least
+  TreeNode *EraseLeast(TreeNode *now, const TreeNode *&least) {
+    if (!now->ls) {
+      least = now;
+      return Retain(now->rs);
+    }
+    TreeNode *left = EraseLeast(now->ls, least);
+    return Rebalance(NewNode(left, Retain(now->rs), now->datum));
+  }
+
+  // the subtree now without key, found tells if it was there at all
+  TreeNode *Erase(TreeNode *now, const Key &key, bool &found) {
+    if (!now) return nullptr;
+    if (Less(key, now->datum.first)) {
+      TreeNode *left = Erase(now->ls, key, found);
+      if (!found) return nullptr;
+      return Rebalance(NewNode(left, Retain(now->rs), now->datum));
+    }
+    if (Less(now->datum.first, key)) {
+      TreeNode *right = Erase(now->rs, key, found);
+      if (!found) return nullptr;
+      return Rebalance(NewNode(Retain(now->ls), right, now->datum));
+    }
+    found = true;
+    if (!now->ls) return Retain(now->rs);
+    if (!now->rs) return Retain(now->ls);
+    // the least node stays alive through the old version while it is copied
+    const TreeNode *least;
+    TreeNode *right = EraseLeast(now->rs, least);
+    return Rebalance(NewNode(Retain(now->ls), right, least->datum));
+  }
+
+  inline const TreeNode *FindValue(const Key &key) const {
+    const TreeNode *now = root;
+    while (now) {
+      if (Less(key, now->datum.first)) {
+        now = now->ls;
+      } else if (Less(now->datum.first, key)) {
+        now = now->rs;
+      } else {
+        return now;
+      }
+    }
+    return nullptr;
+  }
+
+ public:
+  class const_iterator {
+   private:
+    // the way down from the root, the top one is the node pointed to; empty for end()
+    const TreeNode *path[max_height];
+    int depth;
+    const persistent_map *from;
+
+    inline void PushLeft(const TreeNode *now) {
+      for (; now; now = now->ls) path[depth++] = now;
+    }
+
+    inline void PushRight(const TreeNode *now) {
+      for (; now; now = now->rs) path[depth++] = now;
+    }
+
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = persistent_map::value_type;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+    using iterator_category = std::output_iterator_tag;
+    friend class persistent_map;
+
+    explicit const_iterator(const persistent_map *_from = nullptr) : depth(0), from(_from) {}
+    const_iterator(const const_iterator &other) : depth(other.depth), from(other.from) {
+      for (int i = 0; i < depth; ++i) path[i] = other.path[i];
+    }
+    const_iterator &operator=(const const_iterator &other) {
+      depth = other.depth, from = other.from;
+      for (int i = 0; i < depth; ++i) path[i] = other.path[i];
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator stable_iter = *this;
+      ++*this;
+      return stable_iter;
+    }
+
+    const_iterator &operator++() {
+      if (!depth) throw invalid_iterator();
+      const TreeNode *now = path[depth - 1];
+      if (now->rs) {
+        PushLeft(now->rs);
+        return *this;
+      }
+      // climb while coming up from a right son
+      do {
+        now = path[--depth];
+      } while (depth && path[depth - 1]->rs == now);
+      return *this;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator stable_iter = *this;
+      --*this;
+      return stable_iter;
+    }
+
+    const_iterator &operator--() {
+      if (!from || !from->root) throw invalid_iterator();
+      if (!depth) {
+        PushRight(from->root);
+        return *this;
+      }
+      const TreeNode *now = path[depth - 1];
+      if (now->ls) {
+        PushRight(now->ls);
+        return *this;
+      }
+      // climb while coming up from a left son; reaching the top means this was begin()
+      int up = depth;
+      do {
+        now = path[--up];
+      } while (up && path[up - 1]->ls == now);
+      if (!up) throw invalid_iterator();
+      depth = up;
+      return *this;
+    }
+
+    const value_type &operator*() const {
+      if (!depth) throw invalid_iterator();
+      return path[depth - 1]->datum;
+    }
+
+    const value_type *operator->() const {
+      if (!depth) throw invalid_iterator();
+      return &path[depth - 1]->datum;
+    }
+
+    bool operator==(const const_iterator &rhs) const {
+      return from == rhs.from && depth == rhs.depth && (!depth || path[depth - 1] == rhs.path[depth - 1]);
+    }
+
+    bool operator!=(const const_iterator &rhs) const {
+      return !(*this == rhs);
+    }
+  };
+  // nothing can be changed through an iterator of an immutable map
+  typedef const_iterator iterator;
+
+  persistent_map() : root(nullptr), capacity(0) {}
+
+  explicit persistent_map(const Allocator &_alloc) : root(nullptr), capacity(0), alloc(_alloc) {}
+
+  explicit persistent_map(const Compare &comp, const Allocator &_alloc = Allocator())
+      : compare_base<Compare>(comp), root(nullptr), capacity(0), alloc(_alloc) {}
+
+  // a snapshot, O(1)
+  persistent_map(const persistent_map &other)
+      : compare_base<Compare>(other.KeyComp()), root(Retain(other.root)), capacity(other.capacity),
+        alloc(other.alloc) {}
+
+  persistent_map(persistent_map &&other) noexcept
+      : compare_base<Compare>(other.KeyComp()), root(other.root), capacity(other.capacity), alloc(other.alloc) {
+    other.root = nullptr, other.capacity = 0;
+  }
+
+  persistent_map &operator=(const persistent_map &other) {
+    this->KeyComp() = other.KeyComp();
+    TreeNode *old = root;
+    root = Retain(other.root), capacity = other.capacity;
+    Release(old);
+    return *this;
+  }
+
+  persistent_map &operator=(persistent_map &&other) noexcept {
+    if (this == &other) return *this;
+    Release(root);
+    root = other.root, capacity = other.capacity;
+    this->KeyComp() = other.KeyComp();
+    other.root = nullptr, other.capacity = 0;
+    return *this;
+  }
+
+  ~persistent_map() {
+    Release(root);
+  }
+
+  // a copy of the comparator the keys are ordered by
+  key_compare key_comp() const {
+    return this->KeyComp();
+  }
+
+  value_compare value_comp() const {
+    return value_compare(this->KeyComp());
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(alloc);
+  }
+
+  const T &at(const Key &key) const {
+    const TreeNode *now = FindValue(key);
+    if (!now) throw index_out_of_bound();
+    return now->datum.second;
+  }
+
+  const T &operator[](const Key &key) const {
+    return at(key);
+  }
+
+  const_iterator begin() const {
+    return cbegin();
+  }
+
+  const_iterator cbegin() const {
+    const_iterator it(this);
+    it.PushLeft(root);
+    return it;
+  }
+
+  const_iterator end() const {
+    return cend();
+  }
+
+  const_iterator cend() const {
+    return const_iterator(this);
+  }
+
+  bool empty() const {
+    return !capacity;
+  }
+
+  int size() const {
+    return capacity;
+  }
+
+  /**
+   * the version with value in it, this one if its key is already there
+   * O(log n) nodes are copied, everything else is shared with this version
+   */
+  persistent_map insert(const value_type &value) const {
+    bool changed = false, added = false;
+    persistent_map result(nullptr, capacity, this->KeyComp(), alloc);
+    result.root = result.Insert(root, value, false, changed, added);
+    if (!changed) return *this;
+    result.capacity += added;
+    return result;
+  }
+
+  // the version with key mapped to obj, whether key was there or not
+  persistent_map insert_or_assign(const Key &key, const T &obj) const {
+    bool changed = false, added = false;
+    persistent_map result(nullptr, capacity, this->KeyComp(), alloc);
+    result.root = result.Insert(root, value_type(key, obj), true, changed, added);
+    result.capacity += added;
+    return result;
+  }
+
+  // the version without key, this one if key isn't there
+  persistent_map erase(const Key &key) const {
+    bool found = false;
+    persistent_map result(nullptr, capacity - 1, this->KeyComp(), alloc);
+    result.root = result.Erase(root, key, found);
+    if (!found) return *this;
+    return result;
+  }
+
+  // the version with clear() called on it: an empty one
+  persistent_map clear() const {
+    return persistent_map(nullptr, 0, this->KeyComp(), alloc);
+  }
+
+  int count(const Key &key) const {
+    return FindValue(key) ? 1 : 0;
+  }
+
+  const_iterator find(const Key &key) const {
+    const_iterator it(this);
+    const TreeNode *now = root;
+    while (now) {
+      it.path[it.depth++] = now;
+      if (Less(key, now->datum.first)) {
+        now = now->ls;
+      } else if (Less(now->datum.first, key)) {
+        now = now->rs;
+      } else {
+        return it;
+      }
+    }
+    return cend();
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,345 @@
+/**
+ * a map split into N sjtu::map shards, each behind a lock of its own
+ * a key always lives in the shard its Partition picks, so point operations
+ * on keys of different shards run in parallel; iterating merges the shards
+ * back into one ordered sequence
+ */
+#ifndef SJTU_SHARDED_MAP_HPP
+#define SJTU_SHARDED_MAP_HPP
+
+// only for std::less<T> and std::hash<T>
+#include <functional>
+// only for std::mutex and std::lock_guard<M>
+#include <mutex>
+// only for std::index_sequence<I...>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include "map.hpp"
+
+/**
+ * partitions: int operator()(const Key &) picks the shard of a key, in [0, N)
+ *   hash_partition spreads keys by std::hash, so neighbouring keys land in
+ *   different shards; ordered is my_false_type and iterating merges all N shards
+ *   range_partition cuts the key space at N - 1 split keys, shard i holding the
+ *   keys in [split i - 1, split i); ordered is my_true_type and iterating just
+ *   walks the shards one after another, but a skewed key set loads one shard
+ *
+ * thread safety:
+ *   insert, insert_or_assign, erase, find, at, count and for_each may be called
+ *   from any thread at any time; size, empty and clear lock one shard after
+ *   another, so they only see a consistent map when no one writes meanwhile
+ *   values are handed out as copies, a reference would outlive the lock
+ *   begin() and end() take no locks: iterate that way only while no thread
+ *   writes, use for_each otherwise
+ */
+
+namespace sjtu {
+
+template<class Key, int N>
+struct hash_partition {
+  using ordered = my_false_type;
+  int operator()(const Key &key) const {
+    // std::hash of an integer is often the integer itself, mix the bits first
+    unsigned long long code = std::hash<Key>{}(key);
+    code ^= code >> 33, code *= 0xff51afd7ed558ccdull, code ^= code >> 33;
+    return int(code % N);
+  }
+};
+
+template<class Key, int N, class Compare = std::less<Key>>
+struct range_partition {
+  using ordered = my_true_type;
+  // the N - 1 split keys in increasing order
+  std::vector<Key> splits;
+  // the same order as the map's, kept like the map keeps it
+  Compare less;
+  // throw runtime_error if there aren't N - 1 of them
+  explicit range_partition(std::vector<Key> _splits, const Compare &_less = Compare())
+      : splits(std::move(_splits)), less(_less) {
+    if (int(splits.size()) != N - 1) throw runtime_error();
+  }
+  int operator()(const Key &key) const {
+    int lo = 0, hi = N - 1;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (less(key, splits[mid])) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  }
+};
+
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    int N = 16,
+    class Partition = hash_partition<Key, N>,
+    class Allocator = std::allocator<pair<const Key, T>>
+>
+class sharded_map {
+ public:
+  typedef map<Key, T, Compare, Allocator> map_type;
+  typedef typename map_type::value_type value_type;
+  typedef Allocator allocator_type;
+  static constexpr int shard_count = N;
+ private:
+  using ordered_tag = typename Partition::ordered;
+  using shard_iterator = typename map_type::const_iterator;
+
+  /**
+   * own cache line each, so that the locks of neighbouring shards don't bounce
+   * before C++17 operator new ignores the alignas, so a sharded_map on the
+   * heap may start anywhere in a line; the padding keeps the lock and tree
+   * of one shard off the lines of the next one even then
+   */
+  struct alignas(64) Shard {
+    mutable std::mutex lock;
+    map_type tree;
+    char padding[64];
+    Shard() {}
+    Shard(const Compare &comp) : tree(comp) {}
+  };
+
+  Shard shards[N];
+  Partition partition;
+
+  template<std::size_t... I>
+  sharded_map(const Partition &_partition, const Compare &comp, std::index_sequence<I...>)
+      : shards{{((void) I, comp)}...}, partition(_partition) {}
+
+  inline Shard &ShardOf(const Key &key) {
+    return shards[partition(key)];
+  }
+
+  inline const Shard &ShardOf(const Key &key) const {
+    return shards[partition(key)];
+  }
+
+ public:
+  /**
+   * the shards merged in key order
+   * holds the position in every shard; the one with the least key is the
+   * current element: a range partition has them in order already, with a
+   * hash partition the shards with keys left are kept in a min-heap of their
+   * next keys, so ++ costs O(log N) compares on top of the shard's own ++
+   */
+  class const_iterator {
+   private:
+    shard_iterator heads[N];
+    // the shards with keys left, heap[0] is the current one
+    int heap[N];
+    int left;
+    // the shard of the current element, N for end()
+    int current;
+    const sharded_map *from;
+
+    inline bool Before(const Compare &less, int a, int b) const {
+      return less(heads[a]->first, heads[b]->first);
+    }
+
+    inline void SiftDown(int now) {
+      // every shard orders by a copy of the same comparator
+      Compare less = from->shards[0].tree.key_comp();
+      for (;;) {
+        int least = now, ls = now * 2 + 1, rs = now * 2 + 2;
+        if (ls < left && Before(less, heap[ls], heap[least])) least = ls;
+        if (rs < left && Before(less, heap[rs], heap[least])) least = rs;
+        if (least == now) return;
+        std::swap(heap[now], heap[least]);
+        now = least;
+      }
+    }
+
+    inline void Start(my_true_type) {
+      current = 0;
+      while (current < N && heads[current] == from->shards[current].tree.cend()) ++current;
+    }
+
+    inline void Start(my_false_type) {
+      left = 0;
+      for (int i = 0; i < N; ++i) {
+        if (heads[i] != from->shards[i].tree.cend()) heap[left++] = i;
+      }
+      for (int i = left / 2 - 1; i >= 0; --i) SiftDown(i);
+      current = left ? heap[0] : N;
+    }
+
+    inline void Advance(my_true_type) {
+      ++heads[current];
+      while (current < N && heads[current] == from->shards[current].tree.cend()) ++current;
+    }
+
+    inline void Advance(my_false_type) {
+      if (++heads[current] == from->shards[current].tree.cend()) heap[0] = heap[--left];
+      if (left) SiftDown(0);
+      current = left ? heap[0] : N;
+    }
+
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = sharded_map::value_type;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+    using iterator_category = std::output_iterator_tag;
+    friend class sharded_map;
+
+    explicit const_iterator(const sharded_map *_from = nullptr) : left(0), current(N), from(_from) {}
+
+    const_iterator operator++(int) {
+      const_iterator stable_iter = *this;
+      ++*this;
+      return stable_iter;
+    }
+
+    const_iterator &operator++() {
+      if (current == N) throw invalid_iterator();
+      Advance(ordered_tag());
+      return *this;
+    }
+
+    const value_type &operator*() const {
+      if (current == N) throw invalid_iterator();
+      return *heads[current];
+    }
+
+    const value_type *operator->() const {
+      if (current == N) throw invalid_iterator();
+      return &*heads[current];
+    }
+
+    bool operator==(const const_iterator &rhs) const {
+      return from == rhs.from && current == rhs.current && (current == N || heads[current] == rhs.heads[current]);
+    }
+
+    bool operator!=(const const_iterator &rhs) const {
+      return !(*this == rhs);
+    }
+  };
+  typedef const_iterator iterator;
+
+  sharded_map() {}
+
+  explicit sharded_map(const Partition &_partition) : partition(_partition) {}
+
+  // every shard orders its keys by a copy of comp
+  sharded_map(const Partition &_partition, const Compare &comp)
+      : sharded_map(_partition, comp, std::make_index_sequence<N>()) {}
+
+  // the locks can't be copied along, and a copy taken while others write wouldn't mean much
+  sharded_map(const sharded_map &) = delete;
+  sharded_map &operator=(const sharded_map &) = delete;
+
+  /**
+   * a copy of the value of key
+   * throw index_out_of_bound if key isn't there
+   */
+  T at(const Key &key) const {
+    const Shard &shard = ShardOf(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.tree.at(key);
+  }
+
+  // copies the value of key into obj, false (and obj untouched) if key isn't there
+  bool find(const Key &key, T &obj) const {
+    const Shard &shard = ShardOf(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard_iterator it = shard.tree.find(key);
+    if (it == shard.tree.cend()) return false;
+    obj = it->second;
+    return true;
+  }
+
+  int count(const Key &key) const {
+    const Shard &shard = ShardOf(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.tree.count(key);
+  }
+
+  // true if value was put in, false if its key was already there
+  bool insert(const value_type &value) {
+    Shard &shard = ShardOf(value.first);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.tree.insert(value).second;
+  }
+
+  // maps key to obj, true if key wasn't there before
+  bool insert_or_assign(const Key &key, const T &obj) {
+    Shard &shard = ShardOf(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    pair<typename map_type::iterator, bool> result = shard.tree.try_emplace(key, obj);
+    if (!result.second) result.first->second = obj;
+    return result.second;
+  }
+
+  // the number of elements erased, 0 or 1
+  int erase(const Key &key) {
+    Shard &shard = ShardOf(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.tree.erase(key);
+  }
+
+  int size() const {
+    int total = 0;
+    for (const Shard &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      total += shard.tree.size();
+    }
+    return total;
+  }
+
+  bool empty() const {
+    return !size();
+  }
+
+  void clear() {
+    for (Shard &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      shard.tree.clear();
+    }
+  }
+
+  /**
+   * calls visit(value) for every value in key order, with every shard locked
+   * (always in the same order, so two for_each calls can't deadlock)
+   * visit must not call back into the map
+   */
+  template<class Visit>
+  void for_each(Visit visit) const {
+    for (const Shard &shard : shards) shard.lock.lock();
+    try {
+      for (const_iterator it = cbegin(); it.current != N; ++it) visit(*it);
+    } catch (...) {
+      for (const Shard &shard : shards) shard.lock.unlock();
+      throw;
+    }
+    for (const Shard &shard : shards) shard.lock.unlock();
+  }
+
+  const_iterator begin() const {
+    return cbegin();
+  }
+
+  const_iterator cbegin() const {
+    const_iterator it(this);
+    for (int i = 0; i < N; ++i) it.heads[i] = shards[i].tree.cbegin();
+    it.Start(ordered_tag());
+    return it;
+  }
+
+  const_iterator end() const {
+    return cend();
+  }
+
+  const_iterator cend() const {
+    return const_iterator(this);
+  }
+};
+
+}
+
+#endif
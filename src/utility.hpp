@@ -2,6 +2,7 @@
 #define SJTU_UTILITY_HPP
 
 #include <utility>
+#include <tuple>
 
 namespace sjtu {
 
@@ -15,11 +16,20 @@ public:
 	pair(pair &&other) = default;
 	pair(const T1 &x, const T2 &y) : first(x), second(y) {}
 	template<class U1, class U2>
-	pair(U1 &&x, U2 &&y) : first(x), second(y) {}
+	pair(U1 &&x, U2 &&y) : first(std::forward<U1>(x)), second(std::forward<U2>(y)) {}
 	template<class U1, class U2>
 	pair(const pair<U1, U2> &other) : first(other.first), second(other.second) {}
 	template<class U1, class U2>
-	pair(pair<U1, U2> &&other) : first(other.first), second(other.second) {}
+	pair(pair<U1, U2> &&other) : first(std::forward<U1>(other.first)), second(std::forward<U2>(other.second)) {}
+	// build both members in place from the arguments packed in the tuples, like std::pair
+	template<class... Args1, class... Args2>
+	pair(std::piecewise_construct_t, std::tuple<Args1...> x, std::tuple<Args2...> y)
+		: pair(x, y, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>()) {}
+
+private:
+	template<class... Args1, class... Args2, std::size_t... I1, std::size_t... I2>
+	pair(std::tuple<Args1...> &x, std::tuple<Args2...> &y, std::index_sequence<I1...>, std::index_sequence<I2...>)
+		: first(std::forward<Args1>(std::get<I1>(x))...), second(std::forward<Args2>(std::get<I2>(y))...) {}
 };
 
 }